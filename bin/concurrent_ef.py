@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+混合 ef 并发压测：验证 /search 的 ef 按请求生效，不会被并发请求互相覆盖。
+
+做法：
+  1. 每个查询在每个 ef 下串行请求一次，作为参考结果；
+  2. 把所有 (查询, ef) 组合打乱后用线程池并发请求；
+  3. 对比并发结果与串行参考结果（一致率应为 1.0），
+     并以最大 ef 的串行结果为近似真值计算各 ef 的 recall@k，
+     同时统计各 ef 的延迟分位数。
+"""
+import argparse, random, time
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+import requests
+
+
+def search(url, query, k, ef):
+    t0 = time.perf_counter()
+    resp = requests.post(f"{url}/search", json={"query": query, "k": k, "ef": ef}, timeout=60)
+    latency = time.perf_counter() - t0
+    resp.raise_for_status()
+    ids = [r["id"] for r in resp.json().get("results", [])]
+    return ids, latency
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--url", default="http://127.0.0.1:8080")
+    parser.add_argument("--dim", type=int, default=128)
+    parser.add_argument("--k", type=int, default=10)
+    parser.add_argument("--efs", nargs="+", type=int, default=[10, 50, 200])
+    parser.add_argument("--queries", type=int, default=200)
+    parser.add_argument("--threads", type=int, default=16)
+    parser.add_argument("--seed", type=int, default=42)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    queries = [[rng.gauss(0.0, 1.0) for _ in range(args.dim)] for _ in range(args.queries)]
+    efs = sorted(args.efs)
+
+    # 串行参考结果
+    print(f"[SERIAL] {len(queries)} queries x {len(efs)} ef values")
+    reference = {}
+    for qi, q in enumerate(queries):
+        for ef in efs:
+            reference[(qi, ef)], _ = search(args.url, q, args.k, ef)
+
+    # 并发混合 ef
+    tasks = [(qi, ef) for qi in range(len(queries)) for ef in efs]
+    rng.shuffle(tasks)
+    print(f"[CONCURRENT] {len(tasks)} requests on {args.threads} threads")
+    t0 = time.perf_counter()
+    with ThreadPoolExecutor(max_workers=args.threads) as pool:
+        outs = list(pool.map(lambda t: search(args.url, queries[t[0]], args.k, t[1]), tasks))
+    wall = time.perf_counter() - t0
+
+    mismatched = 0
+    per_ef = {ef: {"lat": [], "recall": []} for ef in efs}
+    for (qi, ef), (ids, lat) in zip(tasks, outs):
+        if ids != reference[(qi, ef)]:
+            mismatched += 1
+        truth = set(reference[(qi, efs[-1])])
+        per_ef[ef]["lat"].append(lat * 1000.0)
+        per_ef[ef]["recall"].append(len(truth & set(ids)) / len(truth) if truth else 0.0)
+
+    print(f"[RESULT] QPS={len(tasks) / wall:.1f}  consistency={1.0 - mismatched / len(tasks):.4f} "
+          f"({mismatched} mismatched)")
+    for ef in efs:
+        lat = np.array(per_ef[ef]["lat"])
+        print(f"  ef={ef:<5d} recall@{args.k}={np.mean(per_ef[ef]['recall']):.4f}  "
+              f"p50={np.percentile(lat, 50):.2f}ms  p99={np.percentile(lat, 99):.2f}ms")
+
+    if mismatched:
+        raise SystemExit("concurrent results differ from serial results: ef is leaking between requests")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,186 @@
+#include "attribute_index.h"
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+// 字段和值拼成位图的键；数字、布尔按 JSON 文本表示，所以 2024 与 "2024" 是同一个值
+static std::string term_key(const std::string& field, const json& value)
+{
+    if (value.is_string()) return field + "=" + value.get<std::string>();
+    if (value.is_number() || value.is_boolean()) return field + "=" + value.dump();
+    throw std::invalid_argument("attribute " + field + " must be a string, number, boolean or an array of them");
+}
+
+static AttributeIndex::Filter filter_and(AttributeIndex::Filter a, AttributeIndex::Filter b)
+{
+    if (!a.complement && !b.complement) {
+        a.ids &= b.ids;
+        return a;
+    }
+    if (a.complement && b.complement) {
+        a.ids |= b.ids;  // ~A & ~B = ~(A | B)
+        return a;
+    }
+    if (a.complement) std::swap(a, b);
+    a.ids.andnot(b.ids);  // A & ~B
+    return a;
+}
+
+static AttributeIndex::Filter filter_or(AttributeIndex::Filter a, AttributeIndex::Filter b)
+{
+    if (!a.complement && !b.complement) {
+        a.ids |= b.ids;
+        return a;
+    }
+    if (a.complement && b.complement) {
+        a.ids &= b.ids;  // ~A | ~B = ~(A & B)
+        return a;
+    }
+    if (!a.complement) std::swap(a, b);
+    a.ids.andnot(b.ids);  // ~A | B = ~(A & ~B)
+    return a;
+}
+
+static std::vector<std::string> attr_terms(const json& attrs)
+{
+    if (!attrs.is_object()) throw std::invalid_argument("attrs must be an object");
+    std::vector<std::string> terms;
+    for (auto it = attrs.begin(); it != attrs.end(); ++it) {
+        if (it.value().is_array()) {
+            for (const auto& v : it.value()) terms.push_back(term_key(it.key(), v));
+        } else {
+            terms.push_back(term_key(it.key(), it.value()));
+        }
+    }
+    return terms;
+}
+
+void AttributeIndex::validate(const json& attrs)
+{
+    attr_terms(attrs);
+}
+
+void AttributeIndex::set(uint32_t id, const json& attrs)
+{
+    std::vector<std::string> terms = attr_terms(attrs);
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    remove_locked(id);
+    for (const auto& t : terms) postings_[t].add(id);
+    if (!terms.empty()) terms_by_id_[id] = std::move(terms);
+}
+
+void AttributeIndex::remove(uint32_t id)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    remove_locked(id);
+}
+
+void AttributeIndex::remove_locked(uint32_t id)
+{
+    auto it = terms_by_id_.find(id);
+    if (it == terms_by_id_.end()) return;
+    for (const auto& t : it->second) {
+        auto p = postings_.find(t);
+        if (p == postings_.end()) continue;
+        p->second.remove(id);
+        if (p->second.empty()) postings_.erase(p);
+    }
+    terms_by_id_.erase(it);
+}
+
+size_t AttributeIndex::load(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("cannot open attribute file " + path);
+    std::string line;
+    size_t n = 0, line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        try {
+            json j = json::parse(line);
+            set(j.at("id").get<uint32_t>(), j.at("attrs"));
+        } catch (const std::exception& e) {
+            throw std::runtime_error(path + ":" + std::to_string(line_no) + ": " + e.what());
+        }
+        n++;
+    }
+    return n;
+}
+
+AttributeIndex::Filter AttributeIndex::evaluate(const json& expr) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return evaluate_locked(expr);
+}
+
+AttributeIndex::Filter AttributeIndex::lookup_locked(const std::string& field, const json& values) const
+{
+    Filter f;
+    auto add_value = [&](const json& v) {
+        auto it = postings_.find(term_key(field, v));
+        if (it != postings_.end()) f.ids |= it->second;
+    };
+    if (values.is_array()) {
+        for (const auto& v : values) add_value(v);
+    } else if (values.is_object()) {
+        if (!values.contains("in") || !values["in"].is_array())
+            throw std::invalid_argument("condition on " + field + " must be a value, an array or {\"in\": [...]}");
+        for (const auto& v : values["in"]) add_value(v);
+    } else {
+        add_value(values);
+    }
+    return f;
+}
+
+AttributeIndex::Filter AttributeIndex::evaluate_locked(const json& expr) const
+{
+    if (!expr.is_object()) throw std::invalid_argument("filter must be an object");
+    Filter result;
+    result.complement = true;  // 空条件匹配全部
+    for (auto it = expr.begin(); it != expr.end(); ++it) {
+        const std::string& key = it.key();
+        const json& v = it.value();
+        Filter f;
+        if (key == "$and" || key == "$or") {
+            if (!v.is_array()) throw std::invalid_argument(key + " expects an array of filters");
+            bool is_and = key == "$and";
+            f.complement = is_and;
+            for (const auto& sub : v) {
+                f = is_and ? filter_and(std::move(f), evaluate_locked(sub)) : filter_or(std::move(f), evaluate_locked(sub));
+            }
+        } else if (key == "$not") {
+            f = evaluate_locked(v);
+            f.complement = !f.complement;
+        } else if (!key.empty() && key[0] == '$') {
+            throw std::invalid_argument("unknown filter operator " + key);
+        } else {
+            f = lookup_locked(key, v);
+        }
+        result = filter_and(std::move(result), std::move(f));
+    }
+    return result;
+}
+
+size_t AttributeIndex::ids() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return terms_by_id_.size();
+}
+
+size_t AttributeIndex::terms() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return postings_.size();
+}
+
+size_t AttributeIndex::bytes() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t n = 0;
+    for (const auto& [term, bm] : postings_) n += term.size() + bm.bytes();
+    return n;
+}
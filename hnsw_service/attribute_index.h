@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "roaring_bitmap.h"
+#include "../hnswlib/hnswlib.h"
+#include <../nlohmann/json.hpp>
+
+// 过滤查询用的向量属性：每个 "字段=值" 一个压缩位图，记录具有该属性的 id
+// 属性是 JSON 对象，值可以是字符串、数字、布尔，或它们的数组（多值，如标签）：
+//   {"color": "red", "year": 2024, "tags": ["a", "b"]}
+// 属性按 id 记录，与索引本身无关，热切换索引时保持不变
+class AttributeIndex {
+public:
+    // 过滤表达式求值的结果：complement 为 true 时表示 ids 以外的所有 id
+    struct Filter {
+        RoaringBitmap ids;
+        bool complement = false;
+
+        bool contains(uint32_t id) const { return ids.contains(id) != complement; }
+        // 满足条件的 id 个数，universe 为索引中的元素数
+        uint64_t count(uint64_t universe) const {
+            uint64_t n = ids.cardinality();
+            return complement ? (universe > n ? universe - n : 0) : n;
+        }
+    };
+
+    // 替换 id 原有的全部属性；attrs 格式不对时抛出 std::invalid_argument
+    void set(uint32_t id, const nlohmann::json& attrs);
+    // 只检查格式，不修改
+    static void validate(const nlohmann::json& attrs);
+    void remove(uint32_t id);
+
+    // 从 JSON lines 文件加载，每行 {"id": 123, "attrs": {...}}，返回条数；出错时抛出 std::runtime_error
+    size_t load(const std::string& path);
+
+    // 过滤表达式（JSON）：
+    //   {"color": "red"}                   等于
+    //   {"color": ["red", "blue"]}         等于其中之一，也可写成 {"color": {"in": [...]}}
+    //   {"color": "red", "year": 2024}     同一对象中的多个条件为且
+    //   {"$and": [...]} {"$or": [...]} {"$not": {...}}
+    // 表达式格式不对时抛出 std::invalid_argument
+    Filter evaluate(const nlohmann::json& expr) const;
+
+    size_t ids() const;
+    size_t terms() const;
+    size_t bytes() const;
+
+private:
+    Filter evaluate_locked(const nlohmann::json& expr) const;
+    Filter lookup_locked(const std::string& field, const nlohmann::json& values) const;
+    void remove_locked(uint32_t id);
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, RoaringBitmap> postings_;           // "字段=值" -> id
+    std::unordered_map<uint32_t, std::vector<std::string>> terms_by_id_;  // 更新和删除时用来清理旧属性
+};
+
+// 在 searchBaseLayerST 中逐个候选检查位图，不满足的节点仍用于图遍历，只是不进入结果
+class BitmapFilter : public hnswlib::BaseFilterFunctor {
+public:
+    explicit BitmapFilter(const AttributeIndex::Filter& f) : f_(f) {}
+    bool operator()(hnswlib::labeltype id) override { return f_.contains((uint32_t)id); }
+
+private:
+    const AttributeIndex::Filter& f_;
+};
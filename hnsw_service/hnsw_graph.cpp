@@ -1,4 +1,5 @@
 #include "hnsw_graph.h"
+#include "../hnswlib/hnswlib.h"
 #include <fstream>
 #include <iostream>
 #include <queue>
@@ -152,6 +153,7 @@ bool HNSWGraph::load_from_file(const std::string& path, bool optimized)
 
 void HNSWGraph::initialize_http_client(const std::string& storage_url) const 
 {
+    std::lock_guard<std::mutex> lock(client_mutex);
     if (!http_client) {
         http_client = std::make_unique<httplib::Client>(storage_url.c_str());
         http_client->set_connection_timeout(5);
@@ -171,14 +173,18 @@ void HNSWGraph::initialize_http_client(const std::string& storage_url) const
    
 }
 
-std::vector<float> HNSWGraph::fetch_vector(const std::string& storage_url, uint32_t id) const 
+std::vector<float> HNSWGraph::fetch_vector(const std::string& storage_url, uint32_t id, QueryStats* stats) const 
 {
-    // auto it = vector_cache.find(id);
-    // if (it != vector_cache.end()) 
-    // {
-    //     return it->second;
-    // }
+    if (vector_cache.capacity() > 0) {
+        std::vector<float> cached;
+        if (vector_cache.get(id, cached)) {
+            if (stats) stats->cache_hits++;
+            return cached;
+        }
+        if (stats) stats->cache_misses++;
+    }
 
+    ScopedTimer fetch_timer(timer_slot(stats, &QueryStats::fetch_ns));
     initialize_http_client(storage_url);
     
     const int max_retries = 3;
@@ -194,10 +200,14 @@ std::vector<float> HNSWGraph::fetch_vector(const std::string& storage_url, uint3
                 throw std::runtime_error("HTTP status " + std::to_string(res->status));
             }
             
+            if (stats) {
+                stats->remote_fetches++;
+                stats->remote_fetch_bytes += res->body.size();
+            }
             json j = json::parse(res->body);
-            // vector_cache[id] = j["values"].get<std::vector<float>>();
-            // return vector_cache[id];
-            return j["values"].get<std::vector<float>>();
+            std::vector<float> values = j["values"].get<std::vector<float>>();
+            vector_cache.put(id, values);
+            return values;
 
         } catch (const std::exception& e) {
             if (attempt == max_retries - 1) {
@@ -252,6 +262,7 @@ std::vector<uint32_t> HNSWGraph::get_neighbors(uint32_t id, int level) const
     
     // 从文件读取
     const NodeOffset& info = it->second;
+    std::lock_guard<std::mutex> lock(file_mutex);
     if (!file_stream || !file_stream->is_open()) {
         // std::cout << "DEBUG: File stream not open" << std::endl;
         return {};
@@ -301,23 +312,38 @@ float HNSWGraph::l2_sq(const std::vector<float>& a, const std::vector<float>& b)
 uint32_t HNSWGraph::search_layer_original(const std::string& storage_url,
                                          const std::vector<float>& query,
                                          uint32_t entry_point, 
-                                         int level, size_t ef) const {
+                                         int level, size_t ef, QueryStats* stats) const {
     uint32_t current_node = entry_point;
     
     try {
-        auto current_vec = fetch_vector(storage_url, current_node);
-        float current_dist = l2_sq(query, current_vec);
+        auto current_vec = fetch_vector(storage_url, current_node, stats);
+        float current_dist;
+        {
+            ScopedTimer t(timer_slot(stats, &QueryStats::distance_ns));
+            current_dist = l2_sq(query, current_vec);
+        }
+        if (stats) stats->distance_computations++;
         std::cout << "DEBUG SEARCH: Starting at entry point " << current_node 
                   << " with initial distance " << current_dist << std::endl;
         bool changed;
         do {
             changed = false;
-            auto neighbors = get_neighbors(current_node, level);
+            std::vector<uint32_t> neighbors;
+            {
+                ScopedTimer t(timer_slot(stats, &QueryStats::adjacency_ns));
+                neighbors = get_neighbors(current_node, level);
+            }
+            if (stats) stats->hops++;
             
             for (uint32_t neighbor : neighbors) {
                 try {
-                    auto neighbor_vec = fetch_vector(storage_url, neighbor);
-                    float neighbor_dist = l2_sq(query, neighbor_vec);
+                    auto neighbor_vec = fetch_vector(storage_url, neighbor, stats);
+                    float neighbor_dist;
+                    {
+                        ScopedTimer t(timer_slot(stats, &QueryStats::distance_ns));
+                        neighbor_dist = l2_sq(query, neighbor_vec);
+                    }
+                    if (stats) stats->distance_computations++;
                     std::cout << "DEBUG SEARCH: Checking neighbor " << neighbor 
                               << " with distance " << neighbor_dist << std::endl;
                     if (neighbor_dist < current_dist) {
@@ -340,7 +366,7 @@ uint32_t HNSWGraph::search_layer_original(const std::string& storage_url,
 }
 
 std::vector<std::pair<uint32_t, float>> HNSWGraph::search_base_layer_original(const std::string& storage_url, const std::vector<float>& query,
-    uint32_t entry_point, size_t ef, size_t k) const 
+    uint32_t entry_point, size_t ef, size_t k, QueryStats* stats) const 
 {
     
     using NodeDist = std::pair<float, uint32_t>;
@@ -356,8 +382,13 @@ std::vector<std::pair<uint32_t, float>> HNSWGraph::search_base_layer_original(co
     std::unordered_set<uint32_t> visited;
     
     try {
-        auto entry_vec = fetch_vector(storage_url, entry_point);
-        float entry_dist = l2_sq(query, entry_vec);
+        auto entry_vec = fetch_vector(storage_url, entry_point, stats);
+        float entry_dist;
+        {
+            ScopedTimer t(timer_slot(stats, &QueryStats::distance_ns));
+            entry_dist = l2_sq(query, entry_vec);
+        }
+        if (stats) stats->distance_computations++;
        
         std::cout << "DEBUG SEARCH: Entry point " << entry_point << std::endl;
         std::cout << "DEBUG SEARCH: Entry vector: [" << entry_vec[0] << ", " << entry_vec[1] << ", " << entry_vec[2] << "]" << std::endl;
@@ -389,12 +420,22 @@ std::vector<std::pair<uint32_t, float>> HNSWGraph::search_base_layer_original(co
                   << ", processing node " << node 
                   << " with distance " << dist << std::endl;
 
-        auto neighbors = get_neighbors(node, 0);
+        std::vector<uint32_t> neighbors;
+        {
+            ScopedTimer t(timer_slot(stats, &QueryStats::adjacency_ns));
+            neighbors = get_neighbors(node, 0);
+        }
+        if (stats) stats->hops++;
         for (uint32_t neighbor : neighbors) {
             if (visited.insert(neighbor).second) {
                 try {
-                    auto neighbor_vec = fetch_vector(storage_url, neighbor);
-                    float neighbor_dist = l2_sq(query, neighbor_vec);
+                    auto neighbor_vec = fetch_vector(storage_url, neighbor, stats);
+                    float neighbor_dist;
+                    {
+                        ScopedTimer t(timer_slot(stats, &QueryStats::distance_ns));
+                        neighbor_dist = l2_sq(query, neighbor_vec);
+                    }
+                    if (stats) stats->distance_computations++;
                     
                     std::cout << "DEBUG SEARCH: Neighbor " << neighbor 
                           << ", vector: [" << neighbor_vec[0] << ", " << neighbor_vec[1] << ", " << neighbor_vec[2] << "]"
@@ -421,6 +462,8 @@ std::vector<std::pair<uint32_t, float>> HNSWGraph::search_base_layer_original(co
         }
     }
     
+    if (stats) stats->visited += visited.size();
+
     // 提取并排序最终结果
     std::vector<std::pair<uint32_t, float>> final_results;
     while (!results.empty()) {
@@ -448,7 +491,7 @@ std::vector<std::pair<uint32_t, float>> HNSWGraph::search_base_layer_original(co
 }
 
 std::vector<std::pair<uint32_t, float>> HNSWGraph::search_candidates(const HNSWGraph& g, const std::string& storage_url, const std::vector<float>& query, uint32_t entry_id, 
-    size_t ef, size_t k) const 
+    size_t ef, size_t k, QueryStats* stats) const 
 {
     
     try
@@ -459,22 +502,27 @@ std::vector<std::pair<uint32_t, float>> HNSWGraph::search_candidates(const HNSWG
 
         if (g.max_level == 0) {
             std::cout << "DEBUG: 直接搜索底层" << std::endl;
-            return search_base_layer_original(storage_url, query, entry_id, ef, k);
+            ScopedTimer t(timer_slot(stats, &QueryStats::base_layer_ns));
+            return search_base_layer_original(storage_url, query, entry_id, ef, k, stats);
         }
         
         // 符合原始HNSW算法的分层搜索
         uint32_t current_entry = entry_id;
         
         // 从最高层开始贪心下降
-        for (int level = static_cast<int>(g.max_level); level > 0; --level) {
-            std::cout << "DEBUG: 搜索层级 " << level << std::endl;
-            current_entry = search_layer_original(storage_url, query, current_entry, level, 1);
-            std::cout << "DEBUG: 层级 " << level << " 搜索完成，当前入口: " << current_entry << std::endl;
+        {
+            ScopedTimer t(timer_slot(stats, &QueryStats::upper_layer_ns));
+            for (int level = static_cast<int>(g.max_level); level > 0; --level) {
+                std::cout << "DEBUG: 搜索层级 " << level << std::endl;
+                current_entry = search_layer_original(storage_url, query, current_entry, level, 1, stats);
+                std::cout << "DEBUG: 层级 " << level << " 搜索完成，当前入口: " << current_entry << std::endl;
+            }
         }
         
         // 在底层进行精细搜索
         std::cout << "DEBUG: 开始底层精细搜索" << std::endl;
-        return search_base_layer_original(storage_url, query, current_entry, ef, k);
+        ScopedTimer t(timer_slot(stats, &QueryStats::base_layer_ns));
+        return search_base_layer_original(storage_url, query, current_entry, ef, k, stats);
     }
     catch (const std::exception& e) {
        std::cerr << "搜索过程中发生异常: " << e.what() << std::endl;
@@ -484,4 +532,85 @@ std::vector<std::pair<uint32_t, float>> HNSWGraph::search_candidates(const HNSWG
         std::cerr << "搜索过程中发生未知异常" << std::endl;
         return {};
     }
-}
\ No newline at end of file
+}
+std::vector<std::pair<uint32_t, float>> HNSWGraph::range_search(const std::string& storage_url, const std::vector<float>& query,
+    uint32_t entry_id, float radius, size_t min_results, size_t max_results, QueryStats* stats) const
+{
+    uint32_t entry = entry_id;
+    {
+        ScopedTimer t(timer_slot(stats, &QueryStats::upper_layer_ns));
+        for (int level = static_cast<int>(max_level); level > 0; --level) {
+            entry = search_layer_original(storage_url, query, entry, level, 1, stats);
+        }
+    }
+
+    ScopedTimer t(timer_slot(stats, &QueryStats::base_layer_ns));
+    // 停止、接纳、淘汰的判断都交给 hnswlib 的 stop condition，与普通模式的 /range_search 行为一致
+    hnswlib::RangeSearchStopCondition<float> stop(radius, min_results, max_results);
+    using NodeDist = std::pair<float, uint32_t>;
+    std::priority_queue<NodeDist, std::vector<NodeDist>, std::greater<NodeDist>> candidates;
+    std::priority_queue<NodeDist> results;
+    std::unordered_set<uint32_t> visited;
+
+    auto distance_to = [&](uint32_t id) {
+        auto v = fetch_vector(storage_url, id, stats);
+        ScopedTimer dt(timer_slot(stats, &QueryStats::distance_ns));
+        if (stats) stats->distance_computations++;
+        return l2_sq(query, v);
+    };
+
+    float lower_bound;
+    try {
+        lower_bound = distance_to(entry);
+    } catch (const std::exception& e) {
+        std::cerr << "range_search: failed to fetch entry point " << entry << ": " << e.what() << std::endl;
+        return {};
+    }
+    candidates.push({lower_bound, entry});
+    results.push({lower_bound, entry});
+    stop.add_point_to_result(entry, nullptr, lower_bound);
+    visited.insert(entry);
+
+    while (!candidates.empty()) {
+        auto [dist, node] = candidates.top();
+        if (stop.should_stop_search(dist, lower_bound)) break;
+        candidates.pop();
+
+        std::vector<uint32_t> neighbors;
+        {
+            ScopedTimer at(timer_slot(stats, &QueryStats::adjacency_ns));
+            neighbors = get_neighbors(node, 0);
+        }
+        if (stats) stats->hops++;
+        for (uint32_t nb : neighbors) {
+            if (!visited.insert(nb).second) continue;
+            float d;
+            try {
+                d = distance_to(nb);
+            } catch (const std::exception&) {
+                continue;  // 取不到向量的节点跳过
+            }
+            if (!stop.should_consider_candidate(d, lower_bound)) continue;
+            candidates.push({d, nb});
+            results.push({d, nb});
+            stop.add_point_to_result(nb, nullptr, d);
+            while (stop.should_remove_extra()) {
+                stop.remove_point_from_result(results.top().second, nullptr, results.top().first);
+                results.pop();
+            }
+            if (!results.empty()) lower_bound = results.top().first;
+        }
+    }
+    if (stats) stats->visited += visited.size();
+
+    std::vector<std::pair<float, hnswlib::labeltype>> sorted(results.size());
+    for (size_t i = sorted.size(); i-- > 0; results.pop()) {
+        sorted[i] = {results.top().first, results.top().second};
+    }
+    stop.filter_results(sorted);
+
+    std::vector<std::pair<uint32_t, float>> out;
+    out.reserve(sorted.size());
+    for (const auto& [d, id] : sorted) out.emplace_back(static_cast<uint32_t>(id), d);
+    return out;
+}
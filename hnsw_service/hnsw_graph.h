@@ -7,6 +7,8 @@
 #include <fstream>
 #include <list>
 #include <utility>
+#include <mutex>
+#include <chrono>
 #include "../httplib.h"
 
 struct NodeOffset {
@@ -14,48 +16,105 @@ struct NodeOffset {
     uint32_t degree;
 };
 
-// // 简单的LRU缓存
-// template<typename K, typename V>
-// class LRUCache {
-// private:
-//     size_t capacity_;
-//     std::list<std::pair<K, V>> cache_list_;
-//     std::unordered_map<K, typename std::list<std::pair<K, V>>::iterator> cache_map_;
+// 简单的LRU缓存（线程安全，capacity 为 0 时不缓存）
+template<typename K, typename V>
+class LRUCache {
+private:
+    size_t capacity_;
+    std::list<std::pair<K, V>> cache_list_;
+    std::unordered_map<K, typename std::list<std::pair<K, V>>::iterator> cache_map_;
+    std::mutex mutex_;
 
-// public:
-//     LRUCache(size_t capacity) : capacity_(capacity) {}
-    
-//     V* get(const K& key) {
-//         auto it = cache_map_.find(key);
-//         if (it == cache_map_.end()) return nullptr;
-        
-//         // 移动到前面
-//         cache_list_.splice(cache_list_.begin(), cache_list_, it->second);
-//         return &(it->second->second);
-//     }
-    
-//     void put(const K& key, const V& value) {
-//         auto it = cache_map_.find(key);
-//         if (it != cache_map_.end()) {
-//             // 更新现有值并移动到前面
-//             it->second->second = value;
-//             cache_list_.splice(cache_list_.begin(), cache_list_, it->second);
-//             return;
-//         }
-        
-//         // 添加新元素
-//         cache_list_.emplace_front(key, value);
-//         cache_map_[key] = cache_list_.begin();
-        
-//         // 如果超过容量，移除最旧的
-//         if (cache_map_.size() > capacity_) {
-//             auto last = cache_list_.end();
-//             last--;
-//             cache_map_.erase(last->first);
-//             cache_list_.pop_back();
-//         }
-//     }
-// };
+public:
+    LRUCache(size_t capacity) : capacity_(capacity) {}
+
+    size_t capacity() const { return capacity_; }
+
+    void set_capacity(size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capacity_ = capacity;
+        while (cache_map_.size() > capacity_) {
+            cache_map_.erase(cache_list_.back().first);
+            cache_list_.pop_back();
+        }
+    }
+
+    bool get(const K& key, V& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = cache_map_.find(key);
+        if (it == cache_map_.end()) return false;
+
+        // 移动到前面
+        cache_list_.splice(cache_list_.begin(), cache_list_, it->second);
+        out = it->second->second;
+        return true;
+    }
+
+    void put(const K& key, const V& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (capacity_ == 0) return;
+        auto it = cache_map_.find(key);
+        if (it != cache_map_.end()) {
+            // 更新现有值并移动到前面
+            it->second->second = value;
+            cache_list_.splice(cache_list_.begin(), cache_list_, it->second);
+            return;
+        }
+
+        // 添加新元素
+        cache_list_.emplace_front(key, value);
+        cache_map_[key] = cache_list_.begin();
+
+        // 如果超过容量，移除最旧的
+        if (cache_map_.size() > capacity_) {
+            auto last = cache_list_.end();
+            last--;
+            cache_map_.erase(last->first);
+            cache_list_.pop_back();
+        }
+    }
+};
+
+// 单次查询的统计信息，由调用方在栈上持有，避免并发查询共享计数器
+struct QueryStats {
+    uint64_t hops = 0;
+    uint64_t distance_computations = 0;
+    uint64_t remote_fetches = 0;
+    uint64_t remote_fetch_bytes = 0;
+    uint64_t cache_hits = 0;
+    uint64_t cache_misses = 0;
+    uint64_t visited = 0;
+
+    // 耗时分解（纳秒），仅在 timing 为 true 时统计
+    bool timing = false;
+    uint64_t upper_layer_ns = 0;
+    uint64_t base_layer_ns = 0;
+    uint64_t fetch_ns = 0;
+    uint64_t adjacency_ns = 0;
+    uint64_t distance_ns = 0;
+};
+
+// 把作用域内的耗时累加到 *acc，acc 为空时不计时
+class ScopedTimer {
+public:
+    explicit ScopedTimer(uint64_t* acc) : acc_(acc) {
+        if (acc_) start_ = std::chrono::steady_clock::now();
+    }
+    ~ScopedTimer() {
+        if (acc_) {
+            *acc_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start_).count();
+        }
+    }
+
+private:
+    uint64_t* acc_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+inline uint64_t* timer_slot(QueryStats* stats, uint64_t QueryStats::*field) {
+    return (stats && stats->timing) ? &(stats->*field) : nullptr;
+}
 
 struct HNSWGraph {
     std::vector<std::vector<uint32_t>> adjacency;
@@ -72,8 +131,10 @@ struct HNSWGraph {
     // 缓存
     // mutable LRUCache<uint32_t, std::vector<uint32_t>> neighbors_cache{10000};
     mutable std::unique_ptr<std::ifstream> file_stream;
+    mutable std::mutex file_mutex;    // 并发查询共用 file_stream，seek 与 read 之间不能被打断
     mutable std::unique_ptr<httplib::Client> http_client;
-    mutable std::unordered_map<uint32_t, std::vector<float>> vector_cache;// 简单缓存已获取的向量
+    mutable std::mutex client_mutex;  // 保护 http_client 的延迟创建，请求本身由 httplib 串行化
+    mutable LRUCache<uint32_t, std::vector<float>> vector_cache{0};// 缓存已获取的向量，默认关闭
 
 
     bool load_from_file(const std::string& path, bool optimized = false);
@@ -83,22 +144,28 @@ struct HNSWGraph {
     std::vector<std::pair<uint32_t, float>> search_candidates(
         const HNSWGraph& g, const std::string& storage_url, 
         const std::vector<float>& query, uint32_t entry_id, 
-        size_t ef, size_t k) const;
+        size_t ef, size_t k, QueryStats* stats = nullptr) const;
+
+    // 范围查询：上层贪心下降后，底层按与 hnswlib::RangeSearchStopCondition 相同的规则搜索，
+    // 返回距离不超过 radius 的点（由近到远），最多 max_results 个
+    std::vector<std::pair<uint32_t, float>> range_search(
+        const std::string& storage_url, const std::vector<float>& query, uint32_t entry_id,
+        float radius, size_t min_results, size_t max_results, QueryStats* stats = nullptr) const;
 
     // 分层搜索
     uint32_t search_layer_original(const std::string& storage_url,
                                   const std::vector<float>& query,
                                   uint32_t entry_point, 
-                                  int level, size_t ef) const;
+                                  int level, size_t ef, QueryStats* stats = nullptr) const;
     
     std::vector<std::pair<uint32_t, float>> search_base_layer_original(
         const std::string& storage_url,
         const std::vector<float>& query,
-        uint32_t entry_point, size_t ef, size_t k) const;
+        uint32_t entry_point, size_t ef, size_t k, QueryStats* stats = nullptr) const;
 
     // 工具函数
     float l2_sq(const std::vector<float>& a, const std::vector<float>& b) const;
-    std::vector<float> fetch_vector(const std::string& storage_url, uint32_t id) const;
+    std::vector<float> fetch_vector(const std::string& storage_url, uint32_t id, QueryStats* stats = nullptr) const;
     // std::vector<uint32_t> load_neighbors(uint32_t id) const;
     std::vector<uint32_t> get_neighbors(uint32_t id, int level = 0) const;
 };
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct ReloadStatus {
+    bool running = false;
+    uint64_t generation = 0;     // 每次成功切换加一，启动时加载的索引为 0
+    std::string source;          // 当前服务中的索引文件
+    std::string loading;         // 正在后台加载的索引文件
+    std::string last_error;
+    double last_load_ms = 0;     // 最近一次成功切换的加载 + 预热耗时
+};
+
+// 索引热切换（shared_ptr RCU）
+// 查询通过 load() 拿到当前索引的 shared_ptr 副本，新索引在后台线程加载预热后原子替换；
+// 替换前已开始的查询继续使用旧索引，最后一个引用释放时旧索引随之析构
+template<typename T>
+class HotSwap {
+public:
+    // 加载流程的各个回调，除 load 外都可以为空
+    struct Hooks {
+        // 后台线程中加载并预热新索引，失败时返回空或抛异常
+        std::function<std::shared_ptr<T>(const std::string& source)> load;
+        // 以下三个在写锁内调用，用于把加载期间旧索引收到的写入补到新索引上
+        std::function<void(T& current)> on_start;
+        std::function<void(T& old_index, T& new_index)> before_swap;
+        std::function<void(T& current)> on_failure;
+    };
+
+    HotSwap(std::shared_ptr<T> initial, std::string source) : current_(std::move(initial)) {
+        status_.source = std::move(source);
+    }
+
+    ~HotSwap() {
+        std::lock_guard<std::mutex> lock(worker_mutex_);
+        if (worker_.joinable()) worker_.join();
+    }
+
+    HotSwap(const HotSwap&) = delete;
+    HotSwap& operator=(const HotSwap&) = delete;
+
+    std::shared_ptr<T> load() const {
+        return current_.load(std::memory_order_acquire);
+    }
+
+    // 写操作（insert/delete）持有此锁，保证替换时不会有写入落在即将退役的索引上
+    std::unique_lock<std::mutex> lock_writes() {
+        return std::unique_lock<std::mutex>(write_mutex_);
+    }
+
+    // 已有加载在进行时返回 false
+    bool start_reload(const std::string& source, Hooks hooks) {
+        {
+            std::lock_guard<std::mutex> lock(status_mutex_);
+            if (status_.running) return false;
+            status_.running = true;
+            status_.loading = source;
+        }
+        if (hooks.on_start) {
+            auto lock = lock_writes();
+            hooks.on_start(*load());
+        }
+        std::lock_guard<std::mutex> lock(worker_mutex_);
+        if (worker_.joinable()) worker_.join();
+        worker_ = std::thread([this, source, hooks = std::move(hooks)]() {
+            run_reload(source, hooks);
+        });
+        return true;
+    }
+
+    ReloadStatus status() const {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        return status_;
+    }
+
+private:
+    void run_reload(const std::string& source, const Hooks& hooks) {
+        auto t0 = std::chrono::steady_clock::now();
+        std::shared_ptr<T> fresh;
+        std::string error;
+        try {
+            fresh = hooks.load(source);
+            if (!fresh) error = "failed to load " + source;
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+        if (!fresh) {
+            {
+                auto lock = lock_writes();
+                if (hooks.on_failure) hooks.on_failure(*load());
+            }
+            std::cerr << "[reload] " << source << " failed: " << error << "\n";
+            std::lock_guard<std::mutex> lock(status_mutex_);
+            status_.running = false;
+            status_.loading.clear();
+            status_.last_error = error;
+            return;
+        }
+
+        // old 在写锁外释放：没有查询持有它时，析构旧索引不应阻塞写入
+        std::shared_ptr<T> old;
+        {
+            auto lock = lock_writes();
+            old = load();
+            if (hooks.before_swap) hooks.before_swap(*old, *fresh);
+            current_.store(fresh, std::memory_order_release);
+        }
+        std::cout << "[reload] swapped in " << source << " (" << ms << " ms)\n";
+
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        status_.running = false;
+        status_.generation++;
+        status_.source = source;
+        status_.loading.clear();
+        status_.last_error.clear();
+        status_.last_load_ms = ms;
+    }
+
+    std::atomic<std::shared_ptr<T>> current_;
+    std::mutex write_mutex_;
+    mutable std::mutex status_mutex_;
+    ReloadStatus status_;
+    std::mutex worker_mutex_;
+    std::thread worker_;
+};
@@ -0,0 +1,294 @@
+#include "live_index.h"
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <unordered_set>
+
+// 满了之后按当前容量翻倍，至少增加这么多个槽位
+static constexpr size_t MIN_GROW = 1024;
+
+LiveIndex::LiveIndex(int dim, const std::string& graph_file, bool read_only, bool huge_pages,
+                     const std::string& quant, bool multi_vector)
+    : dim_(dim), quant_(quant)
+{
+    if (multi_vector) {
+        if (!quant.empty()) throw std::invalid_argument("multi-vector indexes cannot be quantized");
+        auto mv = std::make_unique<hnswlib::MultiVectorL2Space<uint32_t>>(dim);
+        mvspace_ = mv.get();
+        space_ = std::move(mv);
+    } else if (quant.empty()) {
+        space_ = std::make_unique<hnswlib::L2Space>(dim);
+    } else if (quant == "sq8") {
+        auto sq8 = std::make_unique<hnswlib::SQ8Space>(dim);
+        sq8->loadParams(graph_file + ".sq8");
+        qspace_ = sq8.get();
+        space_ = std::move(sq8);
+    } else if (quant == "fp16") {
+        auto fp16 = std::make_unique<hnswlib::FP16Space>(dim);
+        qspace_ = fp16.get();
+        space_ = std::move(fp16);
+    } else if (quant == "pq") {
+        // 码本文件里记录了子空间个数 M
+        std::string codebook = graph_file + ".pq";
+        auto pq = std::make_unique<hnswlib::PQSpace>(dim, hnswlib::PQSpace::readM(codebook));
+        pq->loadParams(codebook);
+        qspace_ = pq.get();
+        space_ = std::move(pq);
+    } else {
+        throw std::invalid_argument("unknown quantization " + quant + ", expected sq8, fp16 or pq");
+    }
+
+    if (read_only) {
+        hnsw_ = std::make_unique<hnswlib::HierarchicalNSW<float>>(space_.get());
+        hnsw_->loadIndexMmap(graph_file, space_.get());
+    } else {
+        // 打开 allow_replace_deleted，insert 才能复用已删除节点的槽位
+        hnsw_ = std::make_unique<hnswlib::HierarchicalNSW<float>>(space_.get(), graph_file, false, 0, true, huge_pages);
+    }
+
+    // hnswlib 加载时不检查空间是否与建索引时一致，多向量索引按普通索引加载（或反过来）会读错每个元素
+    size_t stored = hnsw_->size_data_per_element_ - hnsw_->size_links_level0_ - sizeof(hnswlib::labeltype);
+    if (stored != space_->get_data_size()) {
+        throw std::runtime_error(graph_file + " stores " + std::to_string(stored) + " bytes per vector, expected " +
+                                 std::to_string(space_->get_data_size()) + " (check --dim, --quant and --multi-vector)");
+    }
+}
+
+std::priority_queue<std::pair<float, hnswlib::labeltype>>
+LiveIndex::search(const float* query, size_t k, const hnswlib::SearchParams& params) const
+{
+    if (qspace_) {
+        // PQ 的查询是每个子空间到各质心的距离表，SQ8/FP16 原样复制
+        thread_local std::vector<char> prepared;
+        prepared.resize(qspace_->get_query_size());
+        qspace_->prepareQuery(query, prepared.data());
+        std::shared_lock<std::shared_mutex> lock(resize_mutex_);
+        return hnsw_->searchKnn(prepared.data(), k, params);
+    }
+    std::shared_lock<std::shared_mutex> lock(resize_mutex_);
+    return hnsw_->searchKnn(query, k, params);
+}
+
+std::vector<std::pair<float, hnswlib::labeltype>>
+LiveIndex::range_search(const float* query, float radius, size_t min_results, size_t max_results,
+                        hnswlib::BaseFilterFunctor* filter) const
+{
+    hnswlib::RangeSearchStopCondition<float> stop(radius, min_results, max_results);
+    const void* q = query;
+    thread_local std::vector<char> prepared;
+    if (qspace_) {
+        prepared.resize(qspace_->get_query_size());
+        qspace_->prepareQuery(query, prepared.data());
+        q = prepared.data();
+    }
+    std::shared_lock<std::shared_mutex> lock(resize_mutex_);
+    return hnsw_->searchStopConditionClosest(q, stop, filter);
+}
+
+std::vector<LiveIndex::DocHit>
+LiveIndex::search_docs(const float* query, size_t k, size_t ef, hnswlib::BaseFilterFunctor* filter) const
+{
+    if (!mvspace_) throw std::logic_error("not a multi-vector index");
+    hnswlib::MultiVectorSearchStopCondition<uint32_t, float> stop(*mvspace_, k, ef);
+    std::shared_lock<std::shared_mutex> lock(resize_mutex_);
+    auto found = hnsw_->searchStopConditionClosest(query, stop, filter);
+
+    // found 由近到远，只含前 k 个文档的向量；每个文档取第一次出现的（最近的）
+    std::vector<DocHit> docs;
+    std::unordered_set<uint32_t> seen;
+    std::lock_guard<std::mutex> lookup_lock(hnsw_->label_lookup_lock);
+    for (const auto& [dist, label] : found) {
+        auto it = hnsw_->label_lookup_.find(label);
+        if (it == hnsw_->label_lookup_.end()) continue;
+        uint32_t doc = mvspace_->get_doc_id(hnsw_->getDataByInternalId(it->second));
+        if (seen.insert(doc).second) docs.push_back({doc, dist, static_cast<uint32_t>(label)});
+    }
+    return docs;
+}
+
+std::priority_queue<std::pair<float, hnswlib::labeltype>>
+LiveIndex::search_ids(const float* query, size_t k, const std::vector<uint32_t>& ids, hnswlib::SearchStats* stats) const
+{
+    const void* q = query;
+    thread_local std::vector<char> prepared;
+    if (qspace_) {
+        prepared.resize(qspace_->get_query_size());
+        qspace_->prepareQuery(query, prepared.data());
+        q = prepared.data();
+    }
+    // 查询对存储元素：压缩空间中 q 是 prepareQuery 的结果（SQ8/FP16 为 float32 查询，PQ 为距离表），不是编码
+    auto dist = space_->get_query_dist_func();
+    void* param = space_->get_dist_func_param();
+
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> top;
+    size_t computed = 0;
+    std::shared_lock<std::shared_mutex> lock(resize_mutex_);
+    // 整个循环持有 label_lookup_lock：集合本来就小，逐个加锁反而更慢
+    std::lock_guard<std::mutex> lookup_lock(hnsw_->label_lookup_lock);
+    for (uint32_t id : ids) {
+        auto it = hnsw_->label_lookup_.find(id);
+        if (it == hnsw_->label_lookup_.end() || hnsw_->isMarkedDeleted(it->second)) continue;
+        float d = dist(q, hnsw_->getDataByInternalId(it->second), param);
+        computed++;
+        if (top.size() < k) top.emplace(d, id);
+        else if (d < top.top().first) {
+            top.pop();
+            top.emplace(d, id);
+        }
+    }
+    if (stats) stats->distance_computations += computed;
+    return top;
+}
+
+LiveIndex::InsertResult LiveIndex::insert(uint32_t id, const float* vec, uint32_t doc_id)
+{
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    auto r = insert_locked(id, vec, doc_id);
+    if (journaling_) journal_.push_back({id, std::vector<float>(vec, vec + dim_), doc_id});
+    return r;
+}
+
+LiveIndex::InsertResult LiveIndex::insert_locked(uint32_t id, const float* input, uint32_t doc_id)
+{
+    // 压缩索引中存的是编码，不是 float32；多向量索引在向量后面附上文档 id
+    std::vector<char> code;
+    const void* vec = input;
+    if (qspace_) {
+        code.resize(space_->get_data_size());
+        qspace_->encode(input, code.data());
+        vec = code.data();
+    } else if (mvspace_) {
+        code.resize(space_->get_data_size());
+        memcpy(code.data(), input, dim_ * sizeof(float));
+        mvspace_->set_doc_id(code.data(), doc_id);
+        vec = code.data();
+    }
+
+    // 写操作已串行化，下面的检查与随后的 addPoint 之间状态不会变化
+    bool exists = false;
+    bool exists_deleted = false;
+    {
+        std::lock_guard<std::mutex> lock(hnsw_->label_lookup_lock);
+        auto it = hnsw_->label_lookup_.find(id);
+        if (it != hnsw_->label_lookup_.end()) {
+            exists = true;
+            exists_deleted = hnsw_->isMarkedDeleted(it->second);
+        }
+    }
+
+    if (exists) {
+        // 开启 replace_deleted 后 addPoint 拒绝更新已删除的节点，先恢复再更新
+        std::shared_lock<std::shared_mutex> lock(resize_mutex_);
+        if (exists_deleted) hnsw_->unmarkDelete(id);
+        hnsw_->addPoint(vec, id, false);
+        return InsertResult::Updated;
+    }
+
+    bool has_vacancy;
+    {
+        std::lock_guard<std::mutex> lock(hnsw_->deleted_elements_lock);
+        has_vacancy = !hnsw_->deleted_elements.empty();
+    }
+    if (!has_vacancy && hnsw_->cur_element_count >= hnsw_->max_elements_) {
+        std::unique_lock<std::shared_mutex> lock(resize_mutex_);
+        grow_locked();
+    }
+
+    std::shared_lock<std::shared_mutex> lock(resize_mutex_);
+    hnsw_->addPoint(vec, id, true);
+    return has_vacancy ? InsertResult::Replaced : InsertResult::Inserted;
+}
+
+bool LiveIndex::remove(uint32_t id)
+{
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    bool ok = remove_locked(id);
+    if (ok && journaling_) journal_.push_back({id, {}});
+    return ok;
+}
+
+bool LiveIndex::remove_locked(uint32_t id)
+{
+    {
+        std::lock_guard<std::mutex> lock(hnsw_->label_lookup_lock);
+        auto it = hnsw_->label_lookup_.find(id);
+        if (it == hnsw_->label_lookup_.end() || hnsw_->isMarkedDeleted(it->second)) return false;
+    }
+    std::shared_lock<std::shared_mutex> lock(resize_mutex_);
+    hnsw_->markDelete(id);
+    return true;
+}
+
+void LiveIndex::warm(size_t queries, size_t ef) const
+{
+    size_t n = hnsw_->cur_element_count;
+    if (n == 0) return;
+
+    // 先顺序读一遍底层内存，缺页在这里一次性发生，而不是落在切换后的查询上
+    const char* base = hnsw_->data_level0_memory_;
+    size_t bytes = n * hnsw_->size_data_per_element_;
+    volatile char sink = 0;
+    for (size_t off = 0; off < bytes; off += 4096) sink = sink + base[off];
+
+    std::mt19937_64 rng(n);
+    std::uniform_int_distribution<size_t> pick(0, n - 1);
+    hnswlib::SearchParams params;
+    params.ef = ef;
+    std::vector<float> decoded(dim_);
+    for (size_t i = 0; i < queries; i++) {
+        const char* data = hnsw_->getDataByInternalId(pick(rng));
+        const float* q = reinterpret_cast<const float*>(data);
+        if (qspace_) {
+            qspace_->decode(data, decoded.data());
+            q = decoded.data();
+        }
+        search(q, 10, params);
+    }
+}
+
+void LiveIndex::start_journal()
+{
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    journaling_ = true;
+    journal_.clear();
+}
+
+std::vector<LiveIndex::WriteOp> LiveIndex::stop_journal()
+{
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    journaling_ = false;
+    return std::move(journal_);
+}
+
+void LiveIndex::replay(const std::vector<WriteOp>& ops)
+{
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    for (const auto& op : ops) {
+        if (op.vec.empty()) remove_locked(op.id);
+        else insert_locked(op.id, op.vec.data(), op.doc_id);
+    }
+}
+
+void LiveIndex::grow_locked()
+{
+    size_t cap = hnsw_->max_elements_;
+    size_t new_cap = cap + std::max(cap, MIN_GROW);
+    hnsw_->resizeIndex(new_cap);
+    std::cout << "[live_index] resized capacity " << cap << " -> " << new_cap << "\n";
+}
+
+size_t LiveIndex::size() const
+{
+    return hnsw_->cur_element_count;
+}
+
+size_t LiveIndex::deleted() const
+{
+    return hnsw_->num_deleted_;
+}
+
+size_t LiveIndex::capacity() const
+{
+    std::shared_lock<std::shared_mutex> lock(resize_mutex_);
+    return hnsw_->max_elements_;
+}
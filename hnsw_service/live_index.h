@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../hnswlib/hnswlib.h"
+
+// 普通模式下可在线增删的索引
+// 搜索与 addPoint/markDelete 可以并发（hnswlib 自带细粒度锁），
+// 但 resizeIndex 会 realloc 底层内存，必须与所有读写互斥
+class LiveIndex {
+public:
+    enum class InsertResult { Inserted, Updated, Replaced };
+
+    // 热切换期间记录的写操作，vec 为空表示删除
+    struct WriteOp {
+        uint32_t id;
+        std::vector<float> vec;
+        uint32_t doc_id = 0;
+    };
+
+    // /search_docs 的一条结果：文档及其中离查询最近的向量
+    struct DocHit {
+        uint32_t doc_id;
+        float distance;
+        uint32_t id;
+    };
+
+    // read_only 时用 loadIndexMmap 直接映射按页对齐保存的索引，insert/remove 不可用
+    // huge_pages 时底层内存用 2MB 大页（read_only 时不适用）
+    // quant 为 "sq8"/"fp16"/"pq" 时按 index_builder --quant 建出的压缩索引加载，
+    // SQ8 参数读自 graph_file + ".sq8"，PQ 码本读自 graph_file + ".pq"；
+    // 查询和 insert 的向量仍是 float32，由本类负责编码
+    // multi_vector 时按 index_builder --doc-ids 建出的多向量索引加载，每个元素另存所属文档的 id（不支持 quant）
+    // 索引文件中每个元素的大小与上述参数不符时抛出 std::runtime_error
+    LiveIndex(int dim, const std::string& graph_file, bool read_only = false, bool huge_pages = false,
+              const std::string& quant = "", bool multi_vector = false);
+
+    std::priority_queue<std::pair<float, hnswlib::labeltype>>
+    search(const float* query, size_t k, const hnswlib::SearchParams& params) const;
+
+    // 范围查询：返回距离不超过 radius 的点（由近到远），最多 max_results 个
+    // min_results 的作用与 ef 相同：候选在 radius 内、或比已找到的最近 min_results 个点更近时继续扩展
+    // （hnswlib::RangeSearchStopCondition），所以入口点落在半径外时仍会向内搜索
+    std::vector<std::pair<float, hnswlib::labeltype>>
+    range_search(const float* query, float radius, size_t min_results, size_t max_results,
+                 hnswlib::BaseFilterFunctor* filter = nullptr) const;
+
+    // 多向量索引上返回最近的 k 个不同文档（由近到远），每个文档按其最近的向量计距离
+    // 搜索保留 ef 个文档的全部命中向量（hnswlib::MultiVectorSearchStopCondition），ef 小于 k 时按 k；
+    // filter 按向量 id 过滤。非多向量索引时抛出 std::logic_error
+    std::vector<DocHit> search_docs(const float* query, size_t k, size_t ef,
+                                    hnswlib::BaseFilterFunctor* filter = nullptr) const;
+
+    // 只在给定的 id 中暴力计算距离，返回最近的 k 个；不存在或已删除的 id 跳过
+    // 过滤条件很严格时比在图上过滤更快（见 main.cpp 中的代价估计）
+    std::priority_queue<std::pair<float, hnswlib::labeltype>>
+    search_ids(const float* query, size_t k, const std::vector<uint32_t>& ids, hnswlib::SearchStats* stats) const;
+
+    // 已存在的 id 原地更新向量；否则优先复用已删除的槽位，满了就扩容
+    // doc_id 只在多向量索引中使用
+    InsertResult insert(uint32_t id, const float* vec, uint32_t doc_id = 0);
+
+    // id 不存在或已删除时返回 false
+    bool remove(uint32_t id);
+
+    // 以随机节点自身的向量为查询跑 queries 次搜索，把图和向量页读入内存
+    void warm(size_t queries, size_t ef) const;
+
+    // 开启后 insert/remove 会额外记录到日志，供热切换时补到新索引上
+    void start_journal();
+    std::vector<WriteOp> stop_journal();
+    void replay(const std::vector<WriteOp>& ops);
+
+    int dim() const { return dim_; }
+    bool read_only() const { return hnsw_->isReadOnly(); }
+    // 底层内存实际的分配方式：malloc / hugetlb / thp / mmap
+    const char* memory_backing() const { return hnswlib::memoryBackingName(hnsw_->memoryBacking()); }
+    const std::string& quant() const { return quant_; }
+    bool multi_vector() const { return mvspace_ != nullptr; }
+    // 本机 CPU 上实际选用的距离计算指令集（avx512 / avx2 / avx / sse / scalar）
+    const char* simd_level() const { return space_->get_simd_level(); }
+    size_t size() const;       // 含已标记删除的节点
+    size_t max_degree0() const { return hnsw_->maxM0_; }
+    size_t deleted() const;
+    size_t capacity() const;
+
+private:
+    void grow_locked();
+    InsertResult insert_locked(uint32_t id, const float* vec, uint32_t doc_id);
+    bool remove_locked(uint32_t id);
+
+    int dim_;
+    std::string quant_;
+    std::unique_ptr<hnswlib::SpaceInterface<float>> space_;
+    hnswlib::QuantizedSpace* qspace_ = nullptr;  // 非压缩索引时为空
+    hnswlib::BaseMultiVectorSpace<uint32_t>* mvspace_ = nullptr;  // 非多向量索引时为空
+    std::unique_ptr<hnswlib::HierarchicalNSW<float>> hnsw_;
+
+    mutable std::shared_mutex resize_mutex_;  // 搜索和写入持共享锁，扩容持独占锁
+    std::mutex write_mutex_;                  // 串行化 insert/remove，写入频率远低于查询
+
+    bool journaling_ = false;                 // 以下两项由 write_mutex_ 保护
+    std::vector<WriteOp> journal_;
+};
@@ -1,9 +1,19 @@
+#include "attribute_index.h"
 #include "hnsw_graph.h"
+#include "hot_swap.h"
+#include "live_index.h"
+#include "metrics.h"
+#include "search_codec.h"
+#include "shard_router.h"
 #include "../httplib.h"
 #include <../nlohmann/json.hpp>
 #include <fstream>
 #include "../hnswlib/hnswlib.h"
+#include "../tools/common.h"
 #include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 
 using json = nlohmann::json;
 
@@ -15,6 +25,166 @@ size_t get_current_rss_kb() {
     return rss_pages * page_size_kb;
 }
 
+// 纳秒转微秒，profile 输出用
+static double ns_to_us(uint64_t ns) {
+    return ns / 1000.0;
+}
+
+// 普通模式的查询耗时分解（没有远程读取和缓存）
+static json profile_json(const hnswlib::SearchStats& st, uint64_t total_ns) {
+    json p;
+    p["total_us"] = ns_to_us(total_ns);
+    p["upper_layer_us"] = ns_to_us(st.upper_layer_ns);
+    p["base_layer_us"] = ns_to_us(st.base_layer_ns);
+    p["storage_fetch_us"] = 0.0;
+    p["adjacency_read_us"] = 0.0;
+    p["distance_us"] = ns_to_us(st.distance_ns);
+    p["hops"] = st.hops;
+    p["distance_computations"] = st.distance_computations;
+    p["fetches"] = 0;
+    p["cache_hits"] = 0;
+    p["cache_misses"] = 0;
+    p["visited"] = st.visited;
+    return p;
+}
+
+// 优化模式的查询耗时分解
+static json profile_json(const QueryStats& st, uint64_t total_ns) {
+    json p;
+    p["total_us"] = ns_to_us(total_ns);
+    p["upper_layer_us"] = ns_to_us(st.upper_layer_ns);
+    p["base_layer_us"] = ns_to_us(st.base_layer_ns);
+    p["storage_fetch_us"] = ns_to_us(st.fetch_ns);
+    p["adjacency_read_us"] = ns_to_us(st.adjacency_ns);
+    p["distance_us"] = ns_to_us(st.distance_ns);
+    p["hops"] = st.hops;
+    p["distance_computations"] = st.distance_computations;
+    p["fetches"] = st.remote_fetches;
+    p["fetch_bytes"] = st.remote_fetch_bytes;
+    p["cache_hits"] = st.cache_hits;
+    p["cache_misses"] = st.cache_misses;
+    p["visited"] = st.visited;
+    return p;
+}
+
+// 把向量写入 storage_service（/vec/put），失败时抛出 std::runtime_error
+static void write_through(const std::string& storage_host, uint32_t id, const std::vector<float>& v) {
+    VecHeader h{id, static_cast<dim_t>(v.size())};
+    std::string body(sizeof(h), '\0');
+    memcpy(body.data(), &h, sizeof(h));
+    body += vec_to_bytes(v);
+
+    httplib::Client cli(storage_host.c_str());
+    cli.set_connection_timeout(5);
+    auto r = cli.Post("/vec/put", body, "application/octet-stream");
+    if (!r || r->status != 200 || r->body != "OK") {
+        throw std::runtime_error("write-through to " + storage_host + " failed for id=" + std::to_string(id));
+    }
+}
+
+// 从 storage_service 批量读取原始向量（/vec/batch_get），不存在的 id 对应空向量；请求失败时抛出 std::runtime_error
+static std::vector<std::vector<float>> fetch_vectors(const std::string& storage_host, const std::vector<uint32_t>& ids) {
+    httplib::Client cli(storage_host.c_str());
+    cli.set_connection_timeout(5);
+    auto r = cli.Post("/vec/batch_get", json(ids).dump(), "application/json");
+    if (!r || r->status != 200) {
+        throw std::runtime_error("batch_get from " + storage_host + " failed");
+    }
+    json arr = json::parse(r->body);
+    std::vector<std::vector<float>> vecs(ids.size());
+    for (size_t i = 0; i < ids.size() && i < arr.size(); i++) {
+        if (!arr[i].is_null()) vecs[i] = arr[i].get<std::vector<float>>();
+    }
+    return vecs;
+}
+
+// 用原始向量的精确 L2 距离对压缩索引的候选重新排序，返回最近的 k 个（由近到远）
+// storage 中已不存在或维度不符的候选直接丢弃
+static std::vector<std::pair<uint32_t, float>> rerank_exact(const std::string& storage_host, const std::vector<float>& query,
+                                                            const std::vector<std::pair<uint32_t, float>>& candidates, size_t k) {
+    std::vector<uint32_t> ids;
+    ids.reserve(candidates.size());
+    for (const auto& c : candidates) ids.push_back(c.first);
+    auto vecs = fetch_vectors(storage_host, ids);
+
+    size_t dim = query.size();
+    std::vector<std::pair<uint32_t, float>> out;
+    out.reserve(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (vecs[i].size() != dim) continue;
+        out.emplace_back(ids[i], hnswlib::L2Sqr(query.data(), vecs[i].data(), &dim));
+    }
+    size_t n = std::min(k, out.size());
+    std::partial_sort(out.begin(), out.begin() + n, out.end(),
+                      [](const auto& a, const auto& b) { return a.second < b.second; });
+    out.resize(n);
+    return out;
+}
+
+static json reload_status_json(const ReloadStatus& st) {
+    json j;
+    j["running"] = st.running;
+    j["generation"] = st.generation;
+    j["source"] = st.source;
+    if (st.running) j["loading"] = st.loading;
+    if (!st.last_error.empty()) j["last_error"] = st.last_error;
+    j["last_load_ms"] = st.last_load_ms;
+    return j;
+}
+
+// /admin/reload 请求体可为空，或 {"graph": "新索引路径"}，缺省时重新加载启动时的文件
+static std::string reload_source(const httplib::Request& req, const std::string& fallback) {
+    if (req.body.empty()) return fallback;
+    try {
+        return json::parse(req.body).value("graph", fallback);
+    } catch (const json::exception& e) {
+        throw std::invalid_argument(e.what());
+    }
+}
+
+// /range_search 请求：{"query": [...], "radius": r, "min_results": n, "max_results": n}
+// radius 与 /search 返回的 distance 同单位（L2 平方距离）；格式错误时抛出 std::invalid_argument
+// min_results 是搜索至少保留的候选数，作用与 ef 相同（越大越不容易漏掉半径内的点），默认取服务的 ef
+struct RangeRequest {
+    std::vector<float> query;
+    float radius = 0;
+    size_t min_results = 0;
+    size_t max_results = 0;
+    json body;
+};
+
+static RangeRequest parse_range_request(const httplib::Request& req, size_t min_default, size_t max_default) {
+    RangeRequest rr;
+    try {
+        rr.body = json::parse(req.body);
+        rr.query = rr.body.at("query").get<std::vector<float>>();
+        rr.radius = rr.body.at("radius").get<float>();
+        rr.max_results = rr.body.value("max_results", max_default);
+        rr.min_results = std::min(rr.body.value("min_results", min_default), rr.max_results);
+    } catch (const json::exception& e) {
+        throw std::invalid_argument(e.what());
+    }
+    if (!(rr.radius >= 0) || !std::isfinite(rr.radius)) throw std::invalid_argument("radius must be a non-negative number");
+    if (rr.max_results == 0) throw std::invalid_argument("max_results must be positive");
+    // 至少要找一个点，否则入口点在半径外时搜索立即停止
+    rr.min_results = std::max<size_t>(rr.min_results, 1);
+    return rr;
+}
+
+static json range_extra(const RangeRequest& rr, size_t found) {
+    json extra;
+    extra["count"] = found;
+    extra["radius"] = rr.radius;
+    extra["truncated"] = found >= rr.max_results;  // 结果数达到上限，半径内可能还有更多点
+    extra["rss_kb"] = get_current_rss_kb();
+    return extra;
+}
+
+static uint64_t elapsed_ns(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
 int main(int argc, char** argv) {
     struct rlimit mem_limit;
     mem_limit.rlim_cur = 2 * 1024 * 1024 * 1024LL; // 2GB
@@ -29,6 +199,22 @@ int main(int argc, char** argv) {
     uint32_t entry = 0;
     bool optimized = false;
     int dim = 128;
+    size_t cache_size = 0;
+    size_t warm_queries = 1000;  // 热切换时新索引的预热查询数
+    bool use_mmap = false;       // 普通模式只读映射按页对齐保存的索引（index_builder --page-aligned）
+    bool huge_pages = false;     // 普通模式底层内存使用 2MB 大页，不可用时回退，实际方式见 /info
+    std::string quant;           // 普通模式索引的压缩方式（sq8/fp16/pq），须与 index_builder --quant 一致
+    size_t rerank = 0;           // 默认取多少个候选从 storage_service 读原始向量精排，0 为不精排；请求可用 "rerank" 覆盖
+    std::string shard_list;      // --shards host1,host2,...：路由模式，本进程不加载索引，见 shard_router.h
+    uint32_t shard_timeout_ms = 100;  // 路由模式每个分片的截止时间，请求可用 "timeout_ms" 覆盖
+    double shard_ef_scale = 1.0;      // 路由模式分片 ef = max(k, ef * scale)，请求可用 "shard_ef" 直接指定
+    size_t shard_workers = 8;         // 路由模式每个分片的工作线程数（对该分片的最大并发请求数）
+    size_t shard_queue = 64;          // 路由模式每个分片最多排队的请求数，队列满时该分片直接按失败处理
+    bool allow_partial = true;        // 路由模式有分片失败时是否返回其余分片的结果，请求可用 "partial" 覆盖
+    std::string attrs_file;      // 普通模式过滤查询用的属性，JSON lines，见 attribute_index.h
+    double filter_bf_scale = 1.0;     // 过滤查询改用暴力计算的阈值系数，0 为总在图上过滤
+    size_t range_max = 10000;    // /range_search 默认最多返回的结果数，请求可用 "max_results" 覆盖
+    bool multi_vector = false;   // 普通模式加载 index_builder --doc-ids 建出的多向量索引，提供 /search_docs
 
     for (int i=1;i<argc;i++){
         std::string a = argv[i];
@@ -43,40 +229,339 @@ int main(int argc, char** argv) {
             optimized = (val == "1" || val == "true" || val == "True");
         }
         else if (a=="--dim" && i+1<argc) dim = atoi(argv[++i]);
+        else if (a=="--cache" && i+1<argc) cache_size = std::stoul(argv[++i]);
+        else if (a=="--warm" && i+1<argc) warm_queries = std::stoul(argv[++i]);
+        else if (a=="--huge-pages" && i+1<argc) {
+            std::string val = argv[++i];
+            huge_pages = (val == "1" || val == "true" || val == "True");
+        }
+        else if (a=="--quant" && i+1<argc) quant = argv[++i];
+        else if (a=="--rerank" && i+1<argc) rerank = std::stoul(argv[++i]);
+        else if (a=="--mmap" && i+1<argc) {
+            std::string val = argv[++i];
+            use_mmap = (val == "1" || val == "true" || val == "True");
+        }
+        else if (a=="--shards" && i+1<argc) shard_list = argv[++i];
+        else if (a=="--attrs" && i+1<argc) attrs_file = argv[++i];
+        else if (a=="--filter-bf-scale" && i+1<argc) filter_bf_scale = std::stod(argv[++i]);
+        else if (a=="--range-max" && i+1<argc) range_max = std::stoul(argv[++i]);
+        else if (a=="--multi-vector" && i+1<argc) {
+            std::string val = argv[++i];
+            multi_vector = (val == "1" || val == "true" || val == "True");
+        }
+        else if (a=="--shard-timeout-ms" && i+1<argc) shard_timeout_ms = (uint32_t)std::stoul(argv[++i]);
+        else if (a=="--shard-ef-scale" && i+1<argc) shard_ef_scale = std::stod(argv[++i]);
+        else if (a=="--shard-workers" && i+1<argc) shard_workers = std::stoul(argv[++i]);
+        else if (a=="--shard-queue" && i+1<argc) shard_queue = std::stoul(argv[++i]);
+        else if (a=="--allow-partial" && i+1<argc) {
+            std::string val = argv[++i];
+            allow_partial = (val == "1" || val == "true" || val == "True");
+        }
+    }
+
+    const int ep_search = metrics::register_endpoint("/search");
+    const int ep_info = metrics::register_endpoint("/info");
+    const int ep_mem = metrics::register_endpoint("/mem");
+    const int ep_metrics = metrics::register_endpoint("/metrics");
+    const int ep_insert = metrics::register_endpoint("/insert");
+    const int ep_delete = metrics::register_endpoint("/delete");
+    const int ep_reload = metrics::register_endpoint("/admin/reload");
+    const int ep_attrs = metrics::register_endpoint("/attrs");
+    const int ep_range = metrics::register_endpoint("/range_search");
+    const int ep_docs = metrics::register_endpoint("/search_docs");
+    if (multi_vector && (optimized || !shard_list.empty())) {
+        std::cerr << "--multi-vector is only supported in normal mode\n";
+        return 1;
     }
 
     httplib::Server svr;
-    std::unique_ptr<hnswlib::L2Space> l2space;
-    std::unique_ptr<hnswlib::HierarchicalNSW<float>> hnsw;
-    if (!optimized) 
+    // 响应头和响应体分两次写出，keep-alive 连接上开着 Nagle 会与对端的延迟 ACK 叠加出约 40ms 的等待
+    svr.set_tcp_nodelay(true);
+    // 当前服务中的索引，/admin/reload 在后台加载新索引后原子替换
+    std::unique_ptr<HotSwap<LiveIndex>> live;
+    std::unique_ptr<HotSwap<HNSWGraph>> graphs;
+    // 属性按 id 记录，热切换索引时保持不变
+    AttributeIndex attrs;
+    std::unique_ptr<ShardRouter> router;
+    if (!shard_list.empty())
+    {
+        ShardRouter::Options ropts;
+        ropts.hosts = parse_shard_hosts(shard_list);
+        ropts.timeout_ms = shard_timeout_ms;
+        ropts.ef_scale = shard_ef_scale;
+        ropts.workers = shard_workers;
+        ropts.queue_limit = shard_queue;
+        router = std::make_unique<ShardRouter>(ropts);
+        std::cout << "[mode] router over " << router->size() << " shards, deadline " << shard_timeout_ms
+                  << "ms, shard ef scale " << shard_ef_scale << ", " << shard_workers << " workers and queue "
+                  << shard_queue << " per shard\n";
+
+        svr.Post("/search", [&](const httplib::Request& req, httplib::Response& res){
+            metrics::RequestScope scope(ep_search);
+            auto t_start = std::chrono::steady_clock::now();
+            try {
+                SearchRequest sreq = parse_search_request(req, (int)k_default, (int)ef);
+                if (sreq.k <= 0) throw std::invalid_argument("k must be positive");
+                uint32_t timeout = sreq.binary ? shard_timeout_ms : sreq.body.value("timeout_ms", shard_timeout_ms);
+                size_t shard_ef = sreq.binary ? 0 : sreq.body.value("shard_ef", (size_t)0);
+                bool partial_ok = sreq.binary ? allow_partial : sreq.body.value("partial", allow_partial);
+
+                auto r = router->search(sreq.query, sreq.k, sreq.ef, shard_ef, timeout);
+                size_t failed = router->size() - r.ok;
+                metrics::add(metrics::SHARD_REQUESTS, router->size());
+                metrics::add(metrics::SHARD_FAILURES, failed);
+                metrics::add(metrics::SHARD_TIMEOUTS, r.timed_out);
+
+                json shards = json::array();
+                for (const auto& s : r.shards) {
+                    json j;
+                    j["host"] = s.host;
+                    j["ok"] = s.ok;
+                    j["latency_us"] = s.latency_us;
+                    if (s.ok) j["results"] = s.results;
+                    else j["error"] = s.error;
+                    shards.push_back(j);
+                }
+                if (r.ok == 0 || (failed > 0 && !partial_ok)) {
+                    json err;
+                    err["error"] = r.ok == 0 ? "no shard answered" : "shards failed and partial results are disabled";
+                    err["shards"] = shards;
+                    res.status = r.timed_out > 0 ? 504 : 502;
+                    res.set_content(err.dump(), "application/json");
+                    return;
+                }
+                if (failed > 0) metrics::add(metrics::PARTIAL_RESULTS, 1);
+
+                json extra;
+                if (!sreq.binary) {
+                    extra["partial"] = failed > 0;
+                    extra["shard_ef"] = shard_ef ? shard_ef : router->shard_ef(sreq.ef, sreq.k);
+                    extra["shards"] = shards;
+                    if (sreq.profile) extra["profile"] = json{{"total_us", ns_to_us(elapsed_ns(t_start))}};
+                } else if (failed > 0) {
+                    // 二进制响应没有附加字段，用响应头标出部分结果
+                    res.set_header("X-Partial-Results", std::to_string(r.ok) + "/" + std::to_string(router->size()));
+                }
+                send_search_response(sreq, res, r.merged, extra);
+            } catch (const std::invalid_argument &e) {
+                res.status = 400;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+            } catch (const std::exception &e) {
+                res.status = 500;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+            }
+        });
+
+        svr.Get("/info", [&](const httplib::Request&, httplib::Response& res){
+            metrics::RequestScope scope(ep_info);
+            json info;
+            info["mode"] = "router";
+            info["ef"] = ef;
+            info["shard_timeout_ms"] = shard_timeout_ms;
+            info["shard_ef_scale"] = shard_ef_scale;
+            info["shard_workers"] = shard_workers;
+            info["shard_queue"] = shard_queue;
+            info["allow_partial"] = allow_partial;
+            json shards = json::array();
+            uint64_t nodes = 0;
+            auto infos = router->shard_info(std::max<uint32_t>(shard_timeout_ms, 1000));
+            for (size_t i = 0; i < infos.size(); i++) {
+                json j;
+                j["host"] = router->options().hosts[i];
+                try {
+                    j["info"] = infos[i].empty() ? json() : json::parse(infos[i]);
+                    nodes += j["info"].value("nodes", (uint64_t)0);
+                } catch (const json::exception&) {
+                    j["info"] = nullptr;
+                }
+                shards.push_back(j);
+            }
+            info["nodes"] = nodes;
+            info["shards"] = shards;
+            res.set_content(info.dump(), "application/json");
+        });
+    }
+    else if (!optimized) 
     {
         std::cout << "[mode] normal (in-memory)\n";
-        l2space = std::make_unique<hnswlib::L2Space>(dim);
-        hnsw = std::make_unique<hnswlib::HierarchicalNSW<float>>(l2space.get(), graph_file);
-        std::cout << "Loaded HNSW graph: " << hnsw->cur_element_count << " nodes\n";
+        try {
+            live = std::make_unique<HotSwap<LiveIndex>>(
+                std::make_shared<LiveIndex>(dim, graph_file, use_mmap, huge_pages, quant, multi_vector), graph_file);
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to load " << graph_file << ": " << e.what() << "\n";
+            return 1;
+        }
+        std::cout << "Loaded HNSW graph: " << live->load()->size() << " nodes, distance kernel: "
+                  << live->load()->simd_level() << (multi_vector ? ", multi-vector" : "") << "\n";
+        if (!attrs_file.empty()) {
+            try {
+                size_t n = attrs.load(attrs_file);
+                std::cout << "Loaded attributes for " << n << " vectors: " << attrs.terms() << " bitmaps, "
+                          << attrs.bytes() / 1024 << " KB\n";
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << "\n";
+                return 1;
+            }
+        }
 
 
         svr.Post("/search", [&](const httplib::Request& req, httplib::Response& res){
+            metrics::RequestScope scope(ep_search);
+            auto t_start = std::chrono::steady_clock::now();
+            try {
+                SearchRequest sreq = parse_search_request(req, (int)k_default, (int)ef);
+                if (sreq.query.size() != (size_t)dim) {
+                    throw std::invalid_argument("query dim " + std::to_string(sreq.query.size()) +
+                                                " != index dim " + std::to_string(dim));
+                }
+
+                // ef 按请求传入，不再修改共享的 hnsw->ef_（并发请求之间会互相覆盖）
+                // 精排时先从索引多取 rerank 个候选，距离是压缩后的近似值
+                size_t rerank_n = sreq.binary ? rerank : sreq.body.value("rerank", rerank);
+                size_t k_search = std::max<size_t>(sreq.k, rerank_n);
+
+                hnswlib::SearchStats stats;
+                stats.timing = sreq.profile;
+                hnswlib::SearchParams params;
+                params.ef = sreq.ef;
+                params.stats = &stats;
+                auto hnsw = live->load();
+
+                // 过滤查询：位图在图搜索中逐个候选检查。满足条件的 m 个点很少时，图上要走约 ef * maxM0 * n / m
+                // 次距离计算才能凑够结果，不如直接对这 m 个点暴力计算，m^2 < ef * maxM0 * n 时改用暴力
+                std::priority_queue<std::pair<float, hnswlib::labeltype>> result;
+                json filter_info;
+                if (!sreq.binary && sreq.body.contains("filter")) {
+                    auto t_filter = std::chrono::steady_clock::now();
+                    AttributeIndex::Filter filter = attrs.evaluate(sreq.body["filter"]);
+                    uint64_t live_nodes = hnsw->size() - hnsw->deleted();
+                    uint64_t matched = filter.count(live_nodes);
+                    double ef_eff = (double)std::max<size_t>(sreq.ef, k_search);
+                    bool brute = !filter.complement &&
+                        (double)matched <= filter_bf_scale * std::sqrt(ef_eff * hnsw->max_degree0() * (double)live_nodes);
+                    filter_info["matched"] = matched;
+                    filter_info["strategy"] = brute ? "brute_force" : "graph";
+                    if (brute) {
+                        std::vector<uint32_t> ids;
+                        ids.reserve(matched);
+                        filter.ids.for_each([&](uint32_t id) { ids.push_back(id); });
+                        filter_info["eval_us"] = ns_to_us(elapsed_ns(t_filter));
+                        result = hnsw->search_ids(sreq.query.data(), k_search, ids, &stats);
+                    } else {
+                        filter_info["eval_us"] = ns_to_us(elapsed_ns(t_filter));
+                        BitmapFilter functor(filter);
+                        params.isIdAllowed = &functor;
+                        result = hnsw->search(sreq.query.data(), k_search, params);
+                    }
+                } else {
+                    result = hnsw->search(sreq.query.data(), k_search, params);
+                }
+                metrics::add(metrics::HOPS, stats.hops);
+                metrics::add(metrics::DISTANCE_COMPUTATIONS, stats.distance_computations);
+
+                // 结果一律由近到远，与精排、路由模式和优化模式的顺序一致；大顶堆弹出的是最远的，从后往前填
+                std::vector<std::pair<uint32_t, float>> out(result.size());
+                for (size_t i = result.size(); i-- > 0; result.pop())
+                    out[i] = {static_cast<uint32_t>(result.top().second), result.top().first};
+                uint64_t rerank_ns = 0;
+                if (rerank_n > 0) {
+                    auto t_rerank = std::chrono::steady_clock::now();
+                    try {
+                        out = rerank_exact(storage_host, sreq.query, out, sreq.k);
+                    } catch (const std::exception& e) {
+                        res.status = 502;
+                        res.set_content(std::string("error: ") + e.what(), "text/plain");
+                        return;
+                    }
+                    rerank_ns = elapsed_ns(t_rerank);
+                }
+
+                json extra;
+                if (!sreq.binary) {
+                    extra["rss_kb"] = get_current_rss_kb(); // 实时内存占用
+                    if (rerank_n > 0) extra["reranked"] = k_search;
+                    if (!filter_info.is_null()) extra["filter"] = filter_info;
+                    if (sreq.profile) {
+                        extra["profile"] = profile_json(stats, elapsed_ns(t_start));
+                        extra["profile"]["storage_fetch_us"] = ns_to_us(rerank_ns);
+                    }
+                }
+                send_search_response(sreq, res, out, extra);
+            } catch (const std::invalid_argument &e) {
+                res.status = 400;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+            } catch (const std::exception &e) {
+                res.status = 500;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+            }
+        });
+
+        // 范围查询，可带与 /search 相同的 "filter"
+        svr.Post("/range_search", [&](const httplib::Request& req, httplib::Response& res){
+            metrics::RequestScope scope(ep_range);
             try {
-                json j = json::parse(req.body);
-                std::vector<float> query = j["query"].get<std::vector<float>>();
-                int k = j.value("k", k_default);
-                int efq = j.value("ef", ef);
+                RangeRequest rr = parse_range_request(req, ef, range_max);
+                if (rr.query.size() != (size_t)dim) {
+                    throw std::invalid_argument("query dim " + std::to_string(rr.query.size()) +
+                                                " != index dim " + std::to_string(dim));
+                }
+                AttributeIndex::Filter filter;
+                BitmapFilter functor(filter);
+                bool filtered = rr.body.contains("filter");
+                if (filtered) filter = attrs.evaluate(rr.body["filter"]);
 
-                hnsw->setEf(efq);
-                auto result = hnsw->searchKnn(query.data(), k);
+                auto found = live->load()->range_search(rr.query.data(), rr.radius, rr.min_results, rr.max_results,
+                                                        filtered ? &functor : nullptr);
+                std::vector<std::pair<uint32_t, float>> out;
+                out.reserve(found.size());
+                for (const auto& [dist, id] : found) out.emplace_back(static_cast<uint32_t>(id), dist);
 
-                json resp;
-                resp["results"] = json::array();
+                std::string body;
+                write_search_json(body, out, range_extra(rr, out.size()));
+                res.set_content(body, "application/json");
+            } catch (const std::invalid_argument &e) {
+                res.status = 400;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+            } catch (const std::exception &e) {
+                res.status = 500;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+            }
+        });
 
-                while (!result.empty()) {
-                    auto [dist, id] = result.top();
-                    result.pop();
-                    resp["results"].push_back({{"id", id}, {"distance", dist}});
+        // 多向量索引上按文档去重的 k 近邻：{"query": [...], "k": 10, "ef": 200, "filter": {...}}，也接受二进制请求
+        // 结果的 id 为文档 id，distance 为文档中最近的向量的距离；JSON 响应的 "passages" 按顺序给出这些向量的 id
+        svr.Post("/search_docs", [&](const httplib::Request& req, httplib::Response& res){
+            metrics::RequestScope scope(ep_docs);
+            try {
+                if (!multi_vector) throw std::invalid_argument("index is not multi-vector (start with --multi-vector 1)");
+                SearchRequest sreq = parse_search_request(req, (int)k_default, (int)ef);
+                if (sreq.query.size() != (size_t)dim) {
+                    throw std::invalid_argument("query dim " + std::to_string(sreq.query.size()) +
+                                                " != index dim " + std::to_string(dim));
                 }
+                if (sreq.k <= 0) throw std::invalid_argument("k must be positive");
+                AttributeIndex::Filter filter;
+                BitmapFilter functor(filter);
+                bool filtered = !sreq.binary && sreq.body.contains("filter");
+                if (filtered) filter = attrs.evaluate(sreq.body["filter"]);
 
-                resp["rss_kb"] = get_current_rss_kb(); // 实时内存占用
-                res.set_content(resp.dump(), "application/json");
+                auto docs = live->load()->search_docs(sreq.query.data(), sreq.k, sreq.ef, filtered ? &functor : nullptr);
+                std::vector<std::pair<uint32_t, float>> out;
+                json passages = json::array();
+                out.reserve(docs.size());
+                for (const auto& d : docs) {
+                    out.emplace_back(d.doc_id, d.distance);
+                    passages.push_back(d.id);
+                }
+                json extra;
+                if (!sreq.binary) {
+                    extra["passages"] = passages;
+                    extra["rss_kb"] = get_current_rss_kb();
+                }
+                send_search_response(sreq, res, out, extra);
+            } catch (const std::invalid_argument &e) {
+                res.status = 400;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
             } catch (const std::exception &e) {
                 res.status = 500;
                 res.set_content(std::string("error: ") + e.what(), "text/plain");
@@ -84,15 +569,170 @@ int main(int argc, char** argv) {
         });
 
         svr.Get("/info", [&](const httplib::Request&, httplib::Response& res){
+            metrics::RequestScope scope(ep_info);
+            auto hnsw = live->load();
             json info;
-            uint64_t nodes = static_cast<uint64_t>(hnsw->cur_element_count.load());
-            info["nodes"] = nodes;
+            info["nodes"] = static_cast<uint64_t>(hnsw->size());
+            info["deleted"] = static_cast<uint64_t>(hnsw->deleted());
+            info["capacity"] = static_cast<uint64_t>(hnsw->capacity());
+            info["read_only"] = hnsw->read_only();
+            info["huge_pages"] = huge_pages;
+            info["memory_backing"] = hnsw->memory_backing();
+            info["quant"] = hnsw->quant().empty() ? "none" : hnsw->quant();
+            info["multi_vector"] = hnsw->multi_vector();
+            info["rerank"] = rerank;
+            info["simd"] = hnsw->simd_level();
             info["dim"] = dim;
             info["ef"] = ef;
+            info["reload"] = reload_status_json(live->status());
+            info["attributes"] = {{"ids", attrs.ids()}, {"bitmaps", attrs.terms()}, {"bytes", attrs.bytes()}};
             res.set_content(info.dump(), "application/json");
         });
 
-        
+        // 在线插入：{"id": 123, "vector": [...], "attrs": {...}}，先写 storage_service 再写图，attrs 可省略
+        // 多向量索引还须给出 "doc_id"
+        svr.Post("/insert", [&](const httplib::Request& req, httplib::Response& res){
+            metrics::RequestScope scope(ep_insert);
+            if (use_mmap) {
+                res.status = 409;
+                res.set_content("error: index is mapped read-only (--mmap)", "text/plain");
+                return;
+            }
+            uint32_t id;
+            uint32_t doc_id = 0;
+            std::vector<float> vec;
+            json vec_attrs;
+            try {
+                auto j = json::parse(req.body);
+                id = j.at("id").get<uint32_t>();
+                vec = j.at("vector").get<std::vector<float>>();
+                if (multi_vector) doc_id = j.at("doc_id").get<uint32_t>();
+                if (j.contains("attrs")) {
+                    vec_attrs = j["attrs"];
+                    AttributeIndex::validate(vec_attrs);
+                }
+            } catch (const std::invalid_argument& e) {
+                res.status = 400;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+                return;
+            } catch (const json::exception& e) {
+                res.status = 400;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+                return;
+            }
+            if (vec.size() != (size_t)dim) {
+                res.status = 400;
+                res.set_content("error: vector dim " + std::to_string(vec.size()) +
+                                " != index dim " + std::to_string(dim), "text/plain");
+                return;
+            }
+
+            try {
+                write_through(storage_host, id, vec);
+            } catch (const std::exception& e) {
+                res.status = 502;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+                return;
+            }
+
+            try {
+                auto lock = live->lock_writes();
+                auto hnsw = live->load();
+                auto r = hnsw->insert(id, vec.data(), doc_id);
+                if (!vec_attrs.is_null()) attrs.set(id, vec_attrs);
+                json out;
+                out["id"] = id;
+                if (multi_vector) out["doc_id"] = doc_id;
+                out["status"] = r == LiveIndex::InsertResult::Inserted ? "inserted"
+                              : r == LiveIndex::InsertResult::Updated ? "updated" : "replaced";
+                out["nodes"] = static_cast<uint64_t>(hnsw->size());
+                out["capacity"] = static_cast<uint64_t>(hnsw->capacity());
+                res.set_content(out.dump(), "application/json");
+            } catch (const std::exception& e) {
+                res.status = 500;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+            }
+        });
+
+        // 在线删除：{"id": 123}，只打删除标记，槽位留给后续插入复用
+        svr.Post("/delete", [&](const httplib::Request& req, httplib::Response& res){
+            metrics::RequestScope scope(ep_delete);
+            if (use_mmap) {
+                res.status = 409;
+                res.set_content("error: index is mapped read-only (--mmap)", "text/plain");
+                return;
+            }
+            uint32_t id;
+            try {
+                id = json::parse(req.body).at("id").get<uint32_t>();
+            } catch (const json::exception& e) {
+                res.status = 400;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+                return;
+            }
+            auto lock = live->lock_writes();
+            auto hnsw = live->load();
+            if (!hnsw->remove(id)) {
+                res.status = 404;
+                res.set_content("error: id " + std::to_string(id) + " not found", "text/plain");
+                return;
+            }
+            attrs.remove(id);
+            json out;
+            out["id"] = id;
+            out["status"] = "deleted";
+            out["deleted"] = static_cast<uint64_t>(hnsw->deleted());
+            res.set_content(out.dump(), "application/json");
+        });
+
+        // 修改已有向量的属性：{"id": 123, "attrs": {...}}，attrs 为 {} 时清空
+        svr.Post("/attrs", [&](const httplib::Request& req, httplib::Response& res){
+            metrics::RequestScope scope(ep_attrs);
+            try {
+                auto j = json::parse(req.body);
+                uint32_t id = j.at("id").get<uint32_t>();
+                attrs.set(id, j.at("attrs"));
+                json out;
+                out["id"] = id;
+                out["status"] = "updated";
+                res.set_content(out.dump(), "application/json");
+            } catch (const json::exception& e) {
+                res.status = 400;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+            } catch (const std::invalid_argument& e) {
+                res.status = 400;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+            }
+        });
+
+        // 热切换：后台加载并预热新索引，加载期间的 insert/delete 记入旧索引的日志，切换前补到新索引上
+        svr.Post("/admin/reload", [&](const httplib::Request& req, httplib::Response& res){
+            metrics::RequestScope scope(ep_reload);
+            std::string source;
+            try {
+                source = reload_source(req, graph_file);
+            } catch (const std::invalid_argument& e) {
+                res.status = 400;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+                return;
+            }
+
+            HotSwap<LiveIndex>::Hooks hooks;
+            hooks.load = [dim, ef, warm_queries, use_mmap, huge_pages, quant, multi_vector](const std::string& path) {
+                auto fresh = std::make_shared<LiveIndex>(dim, path, use_mmap, huge_pages, quant, multi_vector);
+                fresh->warm(warm_queries, ef);
+                return fresh;
+            };
+            hooks.on_start = [](LiveIndex& cur) { cur.start_journal(); };
+            hooks.before_swap = [](LiveIndex& old_index, LiveIndex& fresh) {
+                fresh.replay(old_index.stop_journal());
+            };
+            hooks.on_failure = [](LiveIndex& cur) { cur.stop_journal(); };
+
+            if (!live->start_reload(source, std::move(hooks))) res.status = 409;
+            else res.status = 202;
+            res.set_content(reload_status_json(live->status()).dump(), "application/json");
+        });
 
     }
     else
@@ -110,48 +750,136 @@ int main(int argc, char** argv) {
 
         std::cout << "Loaded adjacency-only graph: nodes=" << g_ptr->adjacency.size()
                 << ", entry=" << g_ptr->entrypoint << "\n";
+        g_ptr->vector_cache.set_capacity(cache_size);
+        graphs = std::make_unique<HotSwap<HNSWGraph>>(std::move(g_ptr), adj_path);
+        HotSwap<HNSWGraph>* slot = graphs.get();
 
-        svr.Post("/search", [g_ptr, storage_host, k_default, ef](const httplib::Request& req, httplib::Response& res) {
+        svr.Post("/search", [slot, storage_host, k_default, ef, ep_search](const httplib::Request& req, httplib::Response& res) {
+            metrics::RequestScope scope(ep_search);
+            auto t_start = std::chrono::steady_clock::now();
             try {
-                json j = json::parse(req.body);
-                std::vector<float> query = j["query"].get<std::vector<float>>();
-                int k = j.value("k", (int)k_default);
-                int efq = j.value("ef", (int)ef);
-                uint32_t entry_id = j.value("entry_id", (int)g_ptr->entrypoint);
-
-                auto out = g_ptr->search_candidates(*g_ptr, storage_host, query, entry_id, efq, k);
-
-                json resp;
-                resp["results"] = json::array();
-                for (auto &p : out) {
-                    resp["results"].push_back({{"id", p.first}, {"distance", p.second}});
+                auto g_ptr = slot->load();
+                SearchRequest sreq = parse_search_request(req, (int)k_default, (int)ef);
+                uint32_t entry_id = sreq.entry_id >= 0 ? (uint32_t)sreq.entry_id : g_ptr->entrypoint;
+
+                QueryStats stats;
+                stats.timing = sreq.profile;
+                auto out = g_ptr->search_candidates(*g_ptr, storage_host, sreq.query, entry_id, sreq.ef, sreq.k, &stats);
+                metrics::add(metrics::HOPS, stats.hops);
+                metrics::add(metrics::DISTANCE_COMPUTATIONS, stats.distance_computations);
+                metrics::add(metrics::REMOTE_FETCHES, stats.remote_fetches);
+                metrics::add(metrics::REMOTE_FETCH_BYTES, stats.remote_fetch_bytes);
+                metrics::add(metrics::CACHE_HITS, stats.cache_hits);
+                metrics::add(metrics::CACHE_MISSES, stats.cache_misses);
+
+                json extra;
+                if (!sreq.binary) {
+                    extra["rss_kb"] = get_current_rss_kb();
+                    extra["mode"] = "optimized";
+                    if (sreq.profile) extra["profile"] = profile_json(stats, elapsed_ns(t_start));
                 }
-                resp["rss_kb"] = get_current_rss_kb();
-                resp["mode"] = "optimized";
-                res.set_content(resp.dump(), "application/json");
+                send_search_response(sreq, res, out, extra);
+            } catch (const std::invalid_argument &e) {
+                res.status = 400;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+            } catch (const std::exception &e) {
+                res.status = 500;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+            }
+        });
+
+        svr.Post("/range_search", [slot, storage_host, ef, range_max, ep_range](const httplib::Request& req, httplib::Response& res) {
+            metrics::RequestScope scope(ep_range);
+            try {
+                auto g_ptr = slot->load();
+                RangeRequest rr = parse_range_request(req, ef, range_max);
+                int64_t entry_req = rr.body.value("entry_id", int64_t(-1));
+                uint32_t entry_id = entry_req >= 0 ? (uint32_t)entry_req : g_ptr->entrypoint;
+
+                QueryStats stats;
+                auto out = g_ptr->range_search(storage_host, rr.query, entry_id, rr.radius, rr.min_results,
+                                               rr.max_results, &stats);
+                metrics::add(metrics::HOPS, stats.hops);
+                metrics::add(metrics::DISTANCE_COMPUTATIONS, stats.distance_computations);
+                metrics::add(metrics::REMOTE_FETCHES, stats.remote_fetches);
+                metrics::add(metrics::REMOTE_FETCH_BYTES, stats.remote_fetch_bytes);
+                metrics::add(metrics::CACHE_HITS, stats.cache_hits);
+                metrics::add(metrics::CACHE_MISSES, stats.cache_misses);
+
+                json extra = range_extra(rr, out.size());
+                extra["mode"] = "optimized";
+                std::string body;
+                write_search_json(body, out, extra);
+                res.set_content(body, "application/json");
+            } catch (const std::invalid_argument &e) {
+                res.status = 400;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
             } catch (const std::exception &e) {
                 res.status = 500;
                 res.set_content(std::string("error: ") + e.what(), "text/plain");
             }
         });
 
-        svr.Get("/info", [g_ptr, dim, ef, storage_host](const httplib::Request&, httplib::Response& res) {
+        svr.Get("/info", [slot, dim, ef, storage_host, cache_size, ep_info](const httplib::Request&, httplib::Response& res) {
+            metrics::RequestScope scope(ep_info);
+            auto g_ptr = slot->load();
             json info;
             info["nodes"] = g_ptr->adjacency.size();
             info["dim"] = dim;
             info["ef"] = ef;
             info["storage"] = storage_host;
+            info["cache_size"] = cache_size;
             info["mode"] = "optimized";
+            info["reload"] = reload_status_json(slot->status());
             res.set_content(info.dump(), "application/json");
         });
+
+        // 邻接表在内存中，加载即预热；向量在 storage_service，不随图切换
+        svr.Post("/admin/reload", [slot, adj_path, cache_size, ep_reload](const httplib::Request& req, httplib::Response& res) {
+            metrics::RequestScope scope(ep_reload);
+            std::string source;
+            try {
+                source = reload_source(req, adj_path);
+            } catch (const std::invalid_argument& e) {
+                res.status = 400;
+                res.set_content(std::string("error: ") + e.what(), "text/plain");
+                return;
+            }
+            // 与 --graph 一致，传入图文件路径时读取同名的 .adj
+            if (source.size() < 4 || source.compare(source.size() - 4, 4, ".adj") != 0) source += ".adj";
+
+            HotSwap<HNSWGraph>::Hooks hooks;
+            hooks.load = [cache_size](const std::string& path) {
+                auto fresh = std::make_shared<HNSWGraph>();
+                if (!fresh->load_from_file(path, true)) return std::shared_ptr<HNSWGraph>();
+                fresh->vector_cache.set_capacity(cache_size);
+                return fresh;
+            };
+
+            if (!slot->start_reload(source, std::move(hooks))) res.status = 409;
+            else res.status = 202;
+            res.set_content(reload_status_json(slot->status()).dump(), "application/json");
+        });
     }
 
+    if (!router) svr.Get("/admin/reload", [&](const httplib::Request&, httplib::Response& res){
+            metrics::RequestScope scope(ep_reload);
+            ReloadStatus st = live ? live->status() : graphs->status();
+            res.set_content(reload_status_json(st).dump(), "application/json");
+        });
+
     svr.Get("/mem", [&](const httplib::Request&, httplib::Response& res){
+            metrics::RequestScope scope(ep_mem);
             json j;
             j["rss_kb"] = get_current_rss_kb();
             res.set_content(j.dump(), "application/json");
         });
 
+    svr.Get("/metrics", [&](const httplib::Request&, httplib::Response& res){
+            metrics::RequestScope scope(ep_metrics);
+            res.set_content(metrics::render(get_current_rss_kb()), "text/plain; version=0.0.4");
+        });
+
     std::cout<<"hnsw_service listening on port "<<port<<"\n";
     svr.listen("0.0.0.0", port);
     return 0;
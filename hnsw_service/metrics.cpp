@@ -0,0 +1,177 @@
+#include "metrics.h"
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace metrics {
+
+namespace {
+
+// 延迟直方图上界（秒），最后一个桶为 +Inf
+const double kLatencyBounds[LATENCY_BUCKETS - 1] = {
+    0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+    0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0
+};
+
+struct alignas(64) Shard {
+    std::atomic<uint64_t> counters[COUNTER_NUM] = {};
+    std::atomic<uint64_t> requests[MAX_ENDPOINTS] = {};
+    std::atomic<uint64_t> latency_sum_ns[MAX_ENDPOINTS] = {};
+    std::atomic<uint64_t> latency_buckets[MAX_ENDPOINTS][LATENCY_BUCKETS] = {};
+    std::atomic<int64_t> in_flight{0};
+};
+
+// 分片只增不删：线程退出后其计数仍要保留在累计值里
+std::mutex registry_lock;
+std::vector<std::unique_ptr<Shard>> shards;
+std::string endpoint_names[MAX_ENDPOINTS];
+std::atomic<int> endpoint_count{0};
+
+Shard& local_shard() {
+    thread_local Shard* shard = nullptr;
+    if (!shard) {
+        std::lock_guard<std::mutex> lock(registry_lock);
+        shards.push_back(std::make_unique<Shard>());
+        shard = shards.back().get();
+    }
+    return *shard;
+}
+
+// 只有本线程写自己的分片，不需要 lock 前缀的读改写
+template<typename T>
+inline void bump(std::atomic<T>& a, T v) {
+    a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+void write_counter(std::ostringstream& out, const char* name, const char* help, uint64_t v) {
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " counter\n";
+    out << name << " " << v << "\n";
+}
+
+template<typename T>
+void write_gauge(std::ostringstream& out, const char* name, const char* help, T v) {
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " gauge\n";
+    out << name << " " << v << "\n";
+}
+
+}  // namespace
+
+int register_endpoint(const std::string& name) {
+    std::lock_guard<std::mutex> lock(registry_lock);
+    int n = endpoint_count.load();
+    for (int i = 0; i < n; i++) {
+        if (endpoint_names[i] == name) return i;
+    }
+    if (n >= MAX_ENDPOINTS) {
+        throw std::runtime_error("metrics: too many endpoints");
+    }
+    endpoint_names[n] = name;
+    endpoint_count.store(n + 1);
+    return n;
+}
+
+void add(Counter c, uint64_t v) {
+    bump(local_shard().counters[c], v);
+}
+
+void observe_latency(int endpoint, uint64_t nanos) {
+    Shard& s = local_shard();
+    double seconds = nanos / 1e9;
+    int b = 0;
+    while (b < LATENCY_BUCKETS - 1 && seconds > kLatencyBounds[b]) b++;
+    bump(s.latency_buckets[endpoint][b], uint64_t(1));
+    bump(s.latency_sum_ns[endpoint], nanos);
+    bump(s.requests[endpoint], uint64_t(1));
+}
+
+void in_flight_add(int64_t delta) {
+    bump(local_shard().in_flight, delta);
+}
+
+std::string render(size_t rss_kb) {
+    uint64_t counters[COUNTER_NUM] = {};
+    uint64_t requests[MAX_ENDPOINTS] = {};
+    uint64_t latency_sum_ns[MAX_ENDPOINTS] = {};
+    uint64_t buckets[MAX_ENDPOINTS][LATENCY_BUCKETS] = {};
+    int64_t in_flight = 0;
+    int n_endpoints;
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(registry_lock);
+        n_endpoints = endpoint_count.load();
+        names.assign(endpoint_names, endpoint_names + n_endpoints);
+        for (auto& s : shards) {
+            for (int c = 0; c < COUNTER_NUM; c++)
+                counters[c] += s->counters[c].load(std::memory_order_relaxed);
+            for (int e = 0; e < n_endpoints; e++) {
+                requests[e] += s->requests[e].load(std::memory_order_relaxed);
+                latency_sum_ns[e] += s->latency_sum_ns[e].load(std::memory_order_relaxed);
+                for (int b = 0; b < LATENCY_BUCKETS; b++)
+                    buckets[e][b] += s->latency_buckets[e][b].load(std::memory_order_relaxed);
+            }
+            in_flight += s->in_flight.load(std::memory_order_relaxed);
+        }
+    }
+
+    std::ostringstream out;
+
+    out << "# HELP hnsw_requests_total Requests handled, by endpoint.\n";
+    out << "# TYPE hnsw_requests_total counter\n";
+    for (int e = 0; e < n_endpoints; e++)
+        out << "hnsw_requests_total{endpoint=\"" << names[e] << "\"} " << requests[e] << "\n";
+
+    out << "# HELP hnsw_request_duration_seconds Request latency, by endpoint.\n";
+    out << "# TYPE hnsw_request_duration_seconds histogram\n";
+    for (int e = 0; e < n_endpoints; e++) {
+        uint64_t cumulative = 0;
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            cumulative += buckets[e][b];
+            out << "hnsw_request_duration_seconds_bucket{endpoint=\"" << names[e] << "\",le=\"";
+            if (b < LATENCY_BUCKETS - 1) out << kLatencyBounds[b];
+            else out << "+Inf";
+            out << "\"} " << cumulative << "\n";
+        }
+        out << "hnsw_request_duration_seconds_sum{endpoint=\"" << names[e] << "\"} "
+            << latency_sum_ns[e] / 1e9 << "\n";
+        out << "hnsw_request_duration_seconds_count{endpoint=\"" << names[e] << "\"} "
+            << cumulative << "\n";
+    }
+
+    write_counter(out, "hnsw_search_hops_total",
+                  "Graph nodes expanded by searches.", counters[HOPS]);
+    write_counter(out, "hnsw_distance_computations_total",
+                  "Distance computations performed by searches.", counters[DISTANCE_COMPUTATIONS]);
+    write_counter(out, "hnsw_remote_fetches_total",
+                  "Vectors fetched from storage_service.", counters[REMOTE_FETCHES]);
+    write_counter(out, "hnsw_remote_fetch_bytes_total",
+                  "Response bytes received from storage_service.", counters[REMOTE_FETCH_BYTES]);
+    write_counter(out, "hnsw_vector_cache_hits_total",
+                  "Vector cache hits.", counters[CACHE_HITS]);
+    write_counter(out, "hnsw_vector_cache_misses_total",
+                  "Vector cache misses.", counters[CACHE_MISSES]);
+    write_counter(out, "hnsw_shard_requests_total",
+                  "Shard searches sent by the router.", counters[SHARD_REQUESTS]);
+    write_counter(out, "hnsw_shard_failures_total",
+                  "Shard searches that failed or missed the deadline.", counters[SHARD_FAILURES]);
+    write_counter(out, "hnsw_shard_timeouts_total",
+                  "Shard searches that missed the deadline.", counters[SHARD_TIMEOUTS]);
+    write_counter(out, "hnsw_partial_results_total",
+                  "Router searches answered without every shard.", counters[PARTIAL_RESULTS]);
+
+    uint64_t lookups = counters[CACHE_HITS] + counters[CACHE_MISSES];
+    write_gauge(out, "hnsw_vector_cache_hit_ratio",
+                "Vector cache hits over lookups since start.",
+                lookups ? double(counters[CACHE_HITS]) / lookups : 0.0);
+    write_gauge(out, "hnsw_requests_in_flight",
+                "Requests currently being handled.", in_flight);
+    write_gauge(out, "process_resident_memory_bytes",
+                "Resident set size.", uint64_t(rss_kb) * 1024);
+
+    return out.str();
+}
+
+}  // namespace metrics
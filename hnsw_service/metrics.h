@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Prometheus 文本格式的服务指标
+// 每个线程写自己的分片（单写者，relaxed 原子），/metrics 抓取时再汇总，
+// 查询热路径上没有共享写和锁竞争
+namespace metrics {
+
+enum Counter : int {
+    HOPS = 0,
+    DISTANCE_COMPUTATIONS,
+    REMOTE_FETCHES,
+    REMOTE_FETCH_BYTES,
+    CACHE_HITS,
+    CACHE_MISSES,
+    SHARD_REQUESTS,      // 路由模式
+    SHARD_FAILURES,
+    SHARD_TIMEOUTS,
+    PARTIAL_RESULTS,
+    COUNTER_NUM
+};
+
+constexpr int MAX_ENDPOINTS = 16;
+constexpr int LATENCY_BUCKETS = 15;  // 最后一个为 +Inf
+
+// 注册一个端点，返回其下标；需在 listen 之前调用
+int register_endpoint(const std::string& name);
+
+void add(Counter c, uint64_t v);
+void observe_latency(int endpoint, uint64_t nanos);
+void in_flight_add(int64_t delta);
+
+// 汇总所有线程分片，输出文本格式
+std::string render(size_t rss_kb);
+
+// 请求作用域：构造时计入 in-flight，析构时记录延迟与请求数
+class RequestScope {
+public:
+    explicit RequestScope(int endpoint)
+        : endpoint_(endpoint), start_(std::chrono::steady_clock::now()) {
+        in_flight_add(1);
+    }
+
+    ~RequestScope() {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        observe_latency(endpoint_,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        in_flight_add(-1);
+    }
+
+    RequestScope(const RequestScope&) = delete;
+    RequestScope& operator=(const RequestScope&) = delete;
+
+private:
+    int endpoint_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace metrics
@@ -0,0 +1,189 @@
+#include "roaring_bitmap.h"
+#include <iterator>
+
+void RoaringBitmap::Container::to_bitset()
+{
+    bits.assign(WORDS, 0);
+    for (uint16_t low : array) bits[low >> 6] |= uint64_t(1) << (low & 63);
+    card = (uint32_t)array.size();
+    std::vector<uint16_t>().swap(array);
+}
+
+void RoaringBitmap::Container::normalize()
+{
+    if (is_bitset() && card <= ARRAY_MAX) {
+        array.clear();
+        array.reserve(card);
+        for (size_t w = 0; w < WORDS; w++) {
+            uint64_t word = bits[w];
+            while (word) {
+                array.push_back(uint16_t(w * 64 + __builtin_ctzll(word)));
+                word &= word - 1;
+            }
+        }
+        std::vector<uint64_t>().swap(bits);
+    } else if (!is_bitset() && array.size() > ARRAY_MAX) {
+        to_bitset();
+    }
+    if (!is_bitset()) card = (uint32_t)array.size();
+}
+
+void RoaringBitmap::add(uint32_t id)
+{
+    uint16_t key = id >> 16, low = id & 0xFFFF;
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    size_t i = it - keys_.begin();
+    if (it == keys_.end() || *it != key) {
+        keys_.insert(it, key);
+        containers_.insert(containers_.begin() + i, Container());
+    }
+    Container& c = containers_[i];
+    if (c.is_bitset()) {
+        uint64_t& word = c.bits[low >> 6];
+        uint64_t mask = uint64_t(1) << (low & 63);
+        if (!(word & mask)) {
+            word |= mask;
+            c.card++;
+        }
+        return;
+    }
+    auto pos = std::lower_bound(c.array.begin(), c.array.end(), low);
+    if (pos != c.array.end() && *pos == low) return;
+    c.array.insert(pos, low);
+    c.normalize();
+}
+
+void RoaringBitmap::remove(uint32_t id)
+{
+    uint16_t key = id >> 16, low = id & 0xFFFF;
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    if (it == keys_.end() || *it != key) return;
+    size_t i = it - keys_.begin();
+    Container& c = containers_[i];
+    if (c.is_bitset()) {
+        uint64_t& word = c.bits[low >> 6];
+        uint64_t mask = uint64_t(1) << (low & 63);
+        if (!(word & mask)) return;
+        word &= ~mask;
+        c.card--;
+    } else {
+        auto pos = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if (pos == c.array.end() || *pos != low) return;
+        c.array.erase(pos);
+    }
+    c.normalize();
+    if (c.card == 0) erase_at(i);
+}
+
+void RoaringBitmap::erase_at(size_t i)
+{
+    keys_.erase(keys_.begin() + i);
+    containers_.erase(containers_.begin() + i);
+}
+
+uint64_t RoaringBitmap::cardinality() const
+{
+    uint64_t n = 0;
+    for (const auto& c : containers_) n += c.card;
+    return n;
+}
+
+size_t RoaringBitmap::bytes() const
+{
+    size_t n = keys_.capacity() * sizeof(uint16_t) + containers_.capacity() * sizeof(Container);
+    for (const auto& c : containers_) n += c.array.capacity() * sizeof(uint16_t) + c.bits.capacity() * sizeof(uint64_t);
+    return n;
+}
+
+RoaringBitmap::Container RoaringBitmap::combine(const Container& a, const Container& b, Op op)
+{
+    Container out;
+    if (!a.is_bitset() && !b.is_bitset()) {
+        auto dst = std::back_inserter(out.array);
+        if (op == Op::Or) std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), dst);
+        else if (op == Op::And) std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), dst);
+        else std::set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), dst);
+        out.normalize();
+        return out;
+    }
+    // 至少一边是位图：都展开成位图按字运算
+    Container x = a, y = b;
+    if (!x.is_bitset()) x.to_bitset();
+    if (!y.is_bitset()) y.to_bitset();
+    out.bits.resize(WORDS);
+    uint32_t card = 0;
+    for (size_t w = 0; w < WORDS; w++) {
+        uint64_t v = op == Op::Or ? (x.bits[w] | y.bits[w])
+                   : op == Op::And ? (x.bits[w] & y.bits[w])
+                   : (x.bits[w] & ~y.bits[w]);
+        out.bits[w] = v;
+        card += __builtin_popcountll(v);
+    }
+    out.card = card;
+    out.normalize();
+    return out;
+}
+
+RoaringBitmap& RoaringBitmap::operator|=(const RoaringBitmap& o)
+{
+    std::vector<uint16_t> keys;
+    std::vector<Container> containers;
+    size_t i = 0, j = 0;
+    while (i < keys_.size() || j < o.keys_.size()) {
+        if (j == o.keys_.size() || (i < keys_.size() && keys_[i] < o.keys_[j])) {
+            keys.push_back(keys_[i]);
+            containers.push_back(std::move(containers_[i++]));
+        } else if (i == keys_.size() || o.keys_[j] < keys_[i]) {
+            keys.push_back(o.keys_[j]);
+            containers.push_back(o.containers_[j++]);
+        } else {
+            keys.push_back(keys_[i]);
+            containers.push_back(combine(containers_[i++], o.containers_[j++], Op::Or));
+        }
+    }
+    keys_ = std::move(keys);
+    containers_ = std::move(containers);
+    return *this;
+}
+
+RoaringBitmap& RoaringBitmap::operator&=(const RoaringBitmap& o)
+{
+    std::vector<uint16_t> keys;
+    std::vector<Container> containers;
+    size_t i = 0, j = 0;
+    while (i < keys_.size() && j < o.keys_.size()) {
+        if (keys_[i] < o.keys_[j]) {
+            i++;
+        } else if (o.keys_[j] < keys_[i]) {
+            j++;
+        } else {
+            Container c = combine(containers_[i], o.containers_[j], Op::And);
+            if (c.card) {
+                keys.push_back(keys_[i]);
+                containers.push_back(std::move(c));
+            }
+            i++;
+            j++;
+        }
+    }
+    keys_ = std::move(keys);
+    containers_ = std::move(containers);
+    return *this;
+}
+
+RoaringBitmap& RoaringBitmap::andnot(const RoaringBitmap& o)
+{
+    size_t j = 0;
+    for (size_t i = 0; i < keys_.size();) {
+        while (j < o.keys_.size() && o.keys_[j] < keys_[i]) j++;
+        if (j < o.keys_.size() && o.keys_[j] == keys_[i]) {
+            containers_[i] = combine(containers_[i], o.containers_[j], Op::AndNot);
+            if (containers_[i].card == 0) {
+                erase_at(i);
+                continue;
+            }
+        }
+        i++;
+    }
+    return *this;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 压缩位图（roaring 的简化实现），存放某个属性值对应的全部 id
+// id 按高 16 位分桶，每桶一个容器：不超过 4096 个元素时为有序 uint16 数组，超过时为 65536 位的位图。
+// 稀疏属性只占 2 字节/个，稠密属性每桶固定 8KB；contains 是一次桶查找加一次数组二分或位测试
+class RoaringBitmap {
+public:
+    void add(uint32_t id);
+    void remove(uint32_t id);
+
+    bool contains(uint32_t id) const {
+        uint16_t key = id >> 16, low = id & 0xFFFF;
+        auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+        if (it == keys_.end() || *it != key) return false;
+        const Container& c = containers_[it - keys_.begin()];
+        if (c.is_bitset()) return (c.bits[low >> 6] >> (low & 63)) & 1;
+        return std::binary_search(c.array.begin(), c.array.end(), low);
+    }
+
+    uint64_t cardinality() const;
+    bool empty() const { return keys_.empty(); }
+    size_t bytes() const;  // 容器占用的内存
+
+    RoaringBitmap& operator|=(const RoaringBitmap& o);
+    RoaringBitmap& operator&=(const RoaringBitmap& o);
+    RoaringBitmap& andnot(const RoaringBitmap& o);  // 去掉 o 中的 id
+
+    // 按 id 从小到大调用 fn(id)
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        for (size_t i = 0; i < keys_.size(); i++) {
+            uint32_t high = uint32_t(keys_[i]) << 16;
+            const Container& c = containers_[i];
+            if (!c.is_bitset()) {
+                for (uint16_t low : c.array) fn(high | low);
+                continue;
+            }
+            for (size_t w = 0; w < c.bits.size(); w++) {
+                uint64_t word = c.bits[w];
+                while (word) {
+                    fn(high | uint32_t(w * 64 + __builtin_ctzll(word)));
+                    word &= word - 1;
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr size_t ARRAY_MAX = 4096;  // 数组容器的上限，超过后位图更省内存
+    static constexpr size_t WORDS = 65536 / 64;
+
+    struct Container {
+        std::vector<uint16_t> array;  // 数组容器，有序
+        std::vector<uint64_t> bits;   // 位图容器，非空时有 WORDS 个字
+        uint32_t card = 0;
+
+        bool is_bitset() const { return !bits.empty(); }
+        void to_bitset();
+        void normalize();  // 按元素个数在两种表示之间转换
+    };
+
+    enum class Op { Or, And, AndNot };
+    static Container combine(const Container& a, const Container& b, Op op);
+    void erase_at(size_t i);
+
+    std::vector<uint16_t> keys_;  // 有序的高 16 位
+    std::vector<Container> containers_;
+};
@@ -0,0 +1,121 @@
+#include "search_codec.h"
+#include "../tools/common.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+static bool is_binary_request(const httplib::Request& req) {
+    const std::string& ct = req.get_header_value("Content-Type");
+    return ct.rfind("application/octet-stream", 0) == 0;
+}
+
+SearchRequest parse_search_request(const httplib::Request& req, int k_default, int ef_default)
+{
+    SearchRequest sreq;
+    sreq.k = k_default;
+    sreq.ef = ef_default;
+
+    if (is_binary_request(req)) {
+        sreq.binary = true;
+        const std::string& b = req.body;
+        SearchReqHeader h;
+        if (b.size() < sizeof(h)) {
+            throw std::invalid_argument("binary request shorter than header");
+        }
+        memcpy(&h, b.data(), sizeof(h));
+        if (b.size() != sizeof(h) + size_t(h.dim) * sizeof(float)) {
+            throw std::invalid_argument("binary request size does not match dim");
+        }
+        sreq.query.resize(h.dim);
+        memcpy(sreq.query.data(), b.data() + sizeof(h), size_t(h.dim) * sizeof(float));
+        if (h.k) sreq.k = static_cast<int>(h.k);
+        if (h.ef) sreq.ef = static_cast<int>(h.ef);
+        return sreq;
+    }
+
+    try {
+        sreq.body = json::parse(req.body);
+        sreq.query = sreq.body.at("query").get<std::vector<float>>();
+        sreq.k = sreq.body.value("k", k_default);
+        sreq.ef = sreq.body.value("ef", ef_default);
+        sreq.profile = sreq.body.value("profile", false);
+        sreq.entry_id = sreq.body.value("entry_id", int64_t(-1));
+    } catch (const json::exception& e) {
+        throw std::invalid_argument(e.what());
+    }
+    return sreq;
+}
+
+static void append_float(std::string& out, float v)
+{
+    if (!std::isfinite(v)) {
+        out += "null";
+        return;
+    }
+    char buf[32];
+    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, r.ptr);
+}
+
+static void append_uint(std::string& out, uint64_t v)
+{
+    char buf[24];
+    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, r.ptr);
+}
+
+void write_search_json(std::string& out,
+                       const std::vector<std::pair<uint32_t, float>>& results,
+                       const json& extra)
+{
+    out.clear();
+    out.reserve(32 + results.size() * 40);
+    out += "{\"results\":[";
+    for (size_t i = 0; i < results.size(); i++) {
+        if (i) out += ',';
+        out += "{\"id\":";
+        append_uint(out, results[i].first);
+        out += ",\"distance\":";
+        append_float(out, results[i].second);
+        out += '}';
+    }
+    out += ']';
+    for (auto it = extra.begin(); it != extra.end(); ++it) {
+        out += ",\"";
+        out += it.key();
+        out += "\":";
+        out += it.value().dump();
+    }
+    out += '}';
+}
+
+void write_search_binary(std::string& out,
+                         const std::vector<std::pair<uint32_t, float>>& results)
+{
+    uint32_t count = static_cast<uint32_t>(results.size());
+    out.resize(sizeof(count) + count * sizeof(SearchResultEntry));
+    memcpy(out.data(), &count, sizeof(count));
+    char* p = out.data() + sizeof(count);
+    for (uint32_t i = 0; i < count; i++) {
+        SearchResultEntry e{results[i].first, results[i].second};
+        memcpy(p + i * sizeof(e), &e, sizeof(e));
+    }
+}
+
+void send_search_response(const SearchRequest& sreq, httplib::Response& res,
+                          const std::vector<std::pair<uint32_t, float>>& results,
+                          const json& extra)
+{
+    // 直接写进将要交给 httplib 的字符串再移动过去，不再多拷一次；
+    // 按本线程上一次响应的大小预留，写的过程中不必反复扩容（每个响应本身仍需一次分配）
+    thread_local size_t last_size = 0;
+    std::string body;
+    body.reserve(last_size);
+    if (sreq.binary) write_search_binary(body, results);
+    else write_search_json(body, results, extra);
+    last_size = body.size();
+    res.set_content(std::move(body), sreq.binary ? "application/octet-stream" : "application/json");
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../httplib.h"
+#include <../nlohmann/json.hpp>
+
+// /search 请求与响应的编解码
+// JSON 供人工调试；application/octet-stream 为高 QPS 路径，格式见 tools/common.h
+struct SearchRequest {
+    std::vector<float> query;
+    int k = 0;
+    int ef = 0;
+    bool profile = false;
+    bool binary = false;     // 请求为二进制时响应也用二进制
+    int64_t entry_id = -1;   // 仅 JSON，-1 表示使用图的入口点
+    nlohmann::json body;     // JSON 请求的原始内容，供各端点读取额外字段
+};
+
+// 请求格式错误时抛出 std::invalid_argument
+SearchRequest parse_search_request(const httplib::Request& req, int k_default, int ef_default);
+
+// 按结果顺序写出 {"results":[...], <extra 的各字段>}
+// 浮点数用 std::to_chars 直接写入 out，out 可在同一线程的多次请求间复用
+void write_search_json(std::string& out,
+                       const std::vector<std::pair<uint32_t, float>>& results,
+                       const nlohmann::json& extra);
+
+// uint32_t count + count 个 SearchResultEntry
+void write_search_binary(std::string& out,
+                         const std::vector<std::pair<uint32_t, float>>& results);
+
+// 根据请求格式写出响应
+void send_search_response(const SearchRequest& sreq, httplib::Response& res,
+                          const std::vector<std::pair<uint32_t, float>>& results,
+                          const nlohmann::json& extra);
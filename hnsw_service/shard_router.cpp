@@ -0,0 +1,251 @@
+#include "shard_router.h"
+#include "../httplib.h"
+#include "../tools/common.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void set_timeouts(httplib::Client& cli, std::chrono::microseconds t) {
+    t = std::max(t, std::chrono::microseconds(1000));
+    time_t sec = t.count() / 1000000, usec = t.count() % 1000000;
+    cli.set_connection_timeout(sec, usec);
+    cli.set_read_timeout(sec, usec);
+    cli.set_write_timeout(sec, usec);
+}
+
+// 一次查询的汇合点。截止时间后才完成的分片请求仍会写这里，所以用 shared_ptr 持有
+struct Gather {
+    std::mutex lock;
+    std::condition_variable cv;
+    size_t pending = 0;
+    std::vector<ShardRouter::ShardReply> replies;
+    std::vector<std::vector<std::pair<uint32_t, float>>> results;
+    std::vector<bool> done;
+};
+
+// 二进制 /search 响应：uint32_t count + count 个 SearchResultEntry
+bool decode_results(const std::string& body, std::vector<std::pair<uint32_t, float>>& out) {
+    uint32_t count = 0;
+    if (body.size() < sizeof(count)) return false;
+    memcpy(&count, body.data(), sizeof(count));
+    if (body.size() != sizeof(count) + size_t(count) * sizeof(SearchResultEntry)) return false;
+    out.resize(count);
+    const char* p = body.data() + sizeof(count);
+    for (uint32_t i = 0; i < count; i++) {
+        SearchResultEntry e;
+        memcpy(&e, p + i * sizeof(e), sizeof(e));
+        out[i] = {e.id, e.distance};
+    }
+    return true;
+}
+
+// 发给某个分片的一次请求
+struct ShardTask {
+    std::shared_ptr<Gather> g;
+    std::shared_ptr<const std::string> body;
+    size_t index;
+    Clock::time_point start, deadline;
+};
+
+void finish(const ShardTask& t, ShardRouter::ShardReply reply, std::vector<std::pair<uint32_t, float>> results) {
+    reply.latency_us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t.start).count();
+    std::lock_guard<std::mutex> lock(t.g->lock);
+    t.g->replies[t.index] = std::move(reply);
+    t.g->results[t.index] = std::move(results);
+    t.g->done[t.index] = true;
+    if (--t.g->pending == 0) t.g->cv.notify_one();
+}
+
+}  // namespace
+
+// 每个分片固定数量的工作线程，从有界队列取请求；每个线程持有一个长连接
+// （httplib::Client 同一时刻只能发一个请求），出错的连接丢弃，下一个请求时重建
+struct ShardRouter::Shard {
+    std::string host;
+    size_t queue_limit = 0;
+    std::mutex lock;
+    std::condition_variable cv;
+    std::deque<ShardTask> queue;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    Shard(std::string h, size_t nworkers, size_t limit) : host(std::move(h)), queue_limit(limit) {
+        for (size_t i = 0; i < nworkers; i++) workers.emplace_back([this]() { run(); });
+    }
+
+    ~Shard() {
+        {
+            std::lock_guard<std::mutex> g(lock);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    // 队列满时返回 false，不排队
+    bool submit(ShardTask t) {
+        {
+            std::lock_guard<std::mutex> g(lock);
+            if (stopping || queue.size() >= queue_limit) return false;
+            queue.push_back(std::move(t));
+        }
+        cv.notify_one();
+        return true;
+    }
+
+    void run() {
+        std::unique_ptr<httplib::Client> cli;
+        while (true) {
+            ShardTask t;
+            {
+                std::unique_lock<std::mutex> g(lock);
+                cv.wait(g, [&]() { return stopping || !queue.empty(); });
+                if (stopping) return;
+                t = std::move(queue.front());
+                queue.pop_front();
+            }
+            ShardReply reply;
+            reply.host = host;
+            // 排队期间已经过了截止时间，调用方不再等待，不必再发
+            if (Clock::now() >= t.deadline) {
+                reply.timed_out = true;
+                reply.error = "deadline exceeded in queue";
+                finish(t, std::move(reply), {});
+                continue;
+            }
+            if (!cli) {
+                cli = std::make_unique<httplib::Client>(host.c_str());
+                cli->set_keep_alive(true);
+                cli->set_tcp_nodelay(true);
+            }
+            std::vector<std::pair<uint32_t, float>> results;
+            set_timeouts(*cli, std::chrono::duration_cast<std::chrono::microseconds>(t.deadline - Clock::now()));
+            auto r = cli->Post("/search", *t.body, "application/octet-stream");
+            if (!r) {
+                reply.error = httplib::to_string(r.error());
+                // 读超时按发请求时的剩余时间设置，会比 deadline 略早一点触发
+                reply.timed_out = r.error() == httplib::Error::ConnectionTimeout ||
+                                  (r.error() == httplib::Error::Read &&
+                                   Clock::now() + std::chrono::milliseconds(2) >= t.deadline);
+            } else if (r->status != 200) {
+                reply.error = "HTTP " + std::to_string(r->status) + ": " + r->body.substr(0, 200);
+            } else if (!decode_results(r->body, results)) {
+                reply.error = "malformed response";
+            } else {
+                reply.ok = true;
+                reply.results = results.size();
+            }
+            if (!reply.ok) cli.reset();
+            finish(t, std::move(reply), std::move(results));
+        }
+    }
+};
+
+std::vector<std::string> parse_shard_hosts(const std::string& list) {
+    std::vector<std::string> hosts;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) end = list.size();
+        std::string h = list.substr(start, end - start);
+        if (!h.empty()) {
+            if (h.find("://") == std::string::npos) h = "http://" + h;
+            hosts.push_back(h);
+        }
+        start = end + 1;
+    }
+    return hosts;
+}
+
+ShardRouter::ShardRouter(Options opts) : opts_(std::move(opts)) {
+    for (const auto& h : opts_.hosts)
+        shards_.push_back(std::make_shared<Shard>(h, std::max<size_t>(opts_.workers, 1), std::max<size_t>(opts_.queue_limit, 1)));
+}
+
+ShardRouter::~ShardRouter() = default;
+
+size_t ShardRouter::shard_ef(size_t ef, size_t k) const {
+    return std::max(k, (size_t)std::ceil(ef * opts_.ef_scale));
+}
+
+ShardRouter::Result ShardRouter::search(const std::vector<float>& query, size_t k, size_t ef, size_t shard_ef_override,
+                                        uint32_t timeout_ms) const {
+    const size_t n = shards_.size();
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::milliseconds(timeout_ms);
+
+    SearchReqHeader h{(uint32_t)k, (uint32_t)(shard_ef_override ? shard_ef_override : shard_ef(ef, k)),
+                      (dim_t)query.size()};
+    auto body = std::make_shared<std::string>(sizeof(h), '\0');
+    memcpy(body->data(), &h, sizeof(h));
+    *body += vec_to_bytes(query);
+
+    auto g = std::make_shared<Gather>();
+    g->pending = n;
+    g->replies.resize(n);
+    g->results.resize(n);
+    g->done.assign(n, false);
+
+    for (size_t i = 0; i < n; i++) {
+        ShardTask t{g, body, i, start, deadline};
+        if (!shards_[i]->submit(t)) {
+            ShardReply reply;
+            reply.host = shards_[i]->host;
+            reply.error = "shard queue full";
+            finish(t, std::move(reply), {});
+        }
+    }
+
+    Result out;
+    std::vector<std::pair<uint32_t, float>> all;
+    {
+        std::unique_lock<std::mutex> lock(g->lock);
+        g->cv.wait_until(lock, deadline, [&]() { return g->pending == 0; });
+        out.shards.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            if (!g->done[i]) {
+                out.shards[i].host = shards_[i]->host;
+                out.shards[i].timed_out = true;
+                out.shards[i].error = "deadline exceeded";
+                out.shards[i].latency_us = timeout_ms * 1000ull;
+            } else {
+                out.shards[i] = g->replies[i];
+            }
+            if (out.shards[i].ok) {
+                out.ok++;
+                all.insert(all.end(), g->results[i].begin(), g->results[i].end());
+            }
+            if (out.shards[i].timed_out) out.timed_out++;
+        }
+    }
+
+    // 分片互不相交时 id 不会重复；同一数据被多个分片持有时只保留一次
+    std::sort(all.begin(), all.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+    std::unordered_set<uint32_t> seen;
+    for (const auto& r : all) {
+        if (out.merged.size() >= k) break;
+        if (seen.insert(r.first).second) out.merged.push_back(r);
+    }
+    return out;
+}
+
+std::vector<std::string> ShardRouter::shard_info(uint32_t timeout_ms) const {
+    std::vector<std::string> out;
+    for (const auto& s : shards_) {
+        httplib::Client cli(s->host.c_str());
+        set_timeouts(cli, std::chrono::milliseconds(timeout_ms));
+        auto r = cli.Get("/info");
+        out.push_back(r && r->status == 200 ? r->body : std::string());
+    }
+    return out;
+}
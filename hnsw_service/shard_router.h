@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 路由模式：把 /search 并发发给各分片的 hnsw_service，合并各分片的 top-k
+// 分片由 index_builder --shard-id/--shards 建出，id 互不相交，距离可以直接比较。
+// 每个分片有截止时间，超时或出错的分片不等待，用其余分片的结果返回（partial）。
+// 分片 ef = max(k, ceil(ef * ef_scale))：每个分片只有 1/n 的数据，通常不需要全局的 ef
+// 每个分片固定 workers 个线程从有界队列取请求：分片卡住时排队的请求到期即丢弃，
+// 队列满时直接按失败返回，线程数不会随请求增长
+class ShardRouter {
+public:
+    struct Options {
+        std::vector<std::string> hosts;  // 如 http://127.0.0.1:8091
+        uint32_t timeout_ms = 100;       // 每个分片的截止时间
+        double ef_scale = 1.0;
+        size_t workers = 8;              // 每个分片的工作线程数，即对该分片的最大并发请求数
+        size_t queue_limit = 64;         // 每个分片最多排队的请求数，超出的请求该分片直接失败
+    };
+
+    struct ShardReply {
+        std::string host;
+        bool ok = false;
+        bool timed_out = false;
+        std::string error;
+        uint64_t latency_us = 0;
+        size_t results = 0;
+    };
+
+    struct Result {
+        std::vector<std::pair<uint32_t, float>> merged;  // 由近到远，最多 k 个
+        std::vector<ShardReply> shards;                  // 与 hosts 顺序一致
+        size_t ok = 0;
+        size_t timed_out = 0;
+    };
+
+    explicit ShardRouter(Options opts);
+    ~ShardRouter();
+
+    size_t size() const { return shards_.size(); }
+    const Options& options() const { return opts_; }
+    size_t shard_ef(size_t ef, size_t k) const;
+
+    // 查询所有分片，最多等 timeout_ms；shard_ef 为 0 时按 ef_scale 计算
+    Result search(const std::vector<float>& query, size_t k, size_t ef, size_t shard_ef, uint32_t timeout_ms) const;
+
+    // 逐个取各分片的 /info，取不到的为 null
+    std::vector<std::string> shard_info(uint32_t timeout_ms) const;
+
+private:
+    struct Shard;
+    Options opts_;
+    std::vector<std::shared_ptr<Shard>> shards_;
+};
+
+// "host1,host2,..." 拆成地址列表，没有 scheme 的补上 http://
+std::vector<std::string> parse_shard_hosts(const std::string& list);
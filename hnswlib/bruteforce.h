@@ -3,6 +3,8 @@
 #include <fstream>
 #include <mutex>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 #include <assert.h>
 
 namespace hnswlib {
@@ -10,12 +12,15 @@ template<typename dist_t>
 class BruteforceSearch : public AlgorithmInterface<dist_t> {
  public:
     char *data_;
+    LargeAllocation data_alloc_;  // owns data_
+    bool huge_pages_{false};      // back data_ with 2 MB pages, see allocLarge
     size_t maxelements_;
     size_t cur_element_count;
     size_t size_per_element_;
 
     size_t data_size_;
     DISTFUNC <dist_t> fstdistfunc_;
+    DISTFUNC <dist_t> fstquerydistfunc_;
     void *dist_func_param_;
     std::mutex index_lock;
 
@@ -32,8 +37,9 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
     }
 
 
-    BruteforceSearch(SpaceInterface<dist_t> *s, const std::string &location)
+    BruteforceSearch(SpaceInterface<dist_t> *s, const std::string &location, bool huge_pages = false)
         : data_(nullptr),
+            huge_pages_(huge_pages),
             maxelements_(0),
             cur_element_count(0),
             size_per_element_(0),
@@ -43,13 +49,16 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
     }
 
 
-    BruteforceSearch(SpaceInterface <dist_t> *s, size_t maxElements) {
+    BruteforceSearch(SpaceInterface <dist_t> *s, size_t maxElements, bool huge_pages = false)
+        : huge_pages_(huge_pages) {
         maxelements_ = maxElements;
         data_size_ = s->get_data_size();
         fstdistfunc_ = s->get_dist_func();
+        fstquerydistfunc_ = s->get_query_dist_func();
         dist_func_param_ = s->get_dist_func_param();
         size_per_element_ = data_size_ + sizeof(labeltype);
-        data_ = (char *) malloc(maxElements * size_per_element_);
+        data_alloc_ = allocLarge(maxElements * size_per_element_, huge_pages_);
+        data_ = data_alloc_.ptr;
         if (data_ == nullptr)
             throw std::runtime_error("Not enough memory: BruteforceSearch failed to allocate data");
         cur_element_count = 0;
@@ -57,7 +66,12 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
 
 
     ~BruteforceSearch() {
-        free(data_);
+        freeLarge(data_alloc_);
+    }
+
+
+    MemoryBacking memoryBacking() const {
+        return data_alloc_.backing;
     }
 
 
@@ -105,33 +119,131 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
 
     std::priority_queue<std::pair<dist_t, labeltype >>
     searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr) const {
-        assert(k <= cur_element_count);
         std::priority_queue<std::pair<dist_t, labeltype >> topResults;
-        if (cur_element_count == 0) return topResults;
-        for (int i = 0; i < k; i++) {
-            dist_t dist = fstdistfunc_(query_data, data_ + size_per_element_ * i, dist_func_param_);
-            labeltype label = *((labeltype*) (data_ + size_per_element_ * i + data_size_));
-            if ((!isIdAllowed) || (*isIdAllowed)(label)) {
-                topResults.emplace(dist, label);
-            }
-        }
-        dist_t lastdist = topResults.empty() ? std::numeric_limits<dist_t>::max() : topResults.top().first;
-        for (int i = k; i < cur_element_count; i++) {
-            dist_t dist = fstdistfunc_(query_data, data_ + size_per_element_ * i, dist_func_param_);
-            if (dist <= lastdist) {
-                labeltype label = *((labeltype *) (data_ + size_per_element_ * i + data_size_));
-                if ((!isIdAllowed) || (*isIdAllowed)(label)) {
-                    topResults.emplace(dist, label);
-                }
-                if (topResults.size() > k)
-                    topResults.pop();
+        auto result = searchKnnBatch(query_data, 1, k, 1, 0, isIdAllowed);
+        for (const auto &r : result[0])
+            topResults.push(r);
+        return topResults;
+    }
+
 
-                if (!topResults.empty()) {
-                    lastdist = topResults.top().first;
+    // Elements scanned per tile: a tile of the data stays in L2 while every query of the
+    // query tile is compared against it
+    static constexpr size_t kTileBytes = 256 * 1024;
+    static constexpr size_t kQueryTile = 16;
+
+    /*
+    * Exact k nearest neighbours of nq queries stored back to back, closer first.
+    * num_threads == 0 uses all cores. Quantized spaces take queries of a different size than the
+    * stored elements, pass their get_query_size() as query_size (0 means data_size_).
+    *
+    * The scan is tiled like a matrix product: queries are taken kQueryTile at a time and the
+    * data kTileBytes at a time, and each data tile is compared against all queries of the
+    * query tile before moving on, so it is read from memory once per query tile instead of
+    * once per query. The data is also cut into slices so that a single query (or a batch
+    * smaller than the thread count) is still spread over all threads. Every (query, slice)
+    * pair has its own bounded heap, owned by the thread that scans the slice; the heaps of a
+    * query are merged once at the end.
+    */
+    std::vector<std::vector<std::pair<dist_t, labeltype>>>
+    searchKnnBatch(const void *queries, size_t nq, size_t k, size_t num_threads = 0,
+                   size_t query_size = 0, BaseFilterFunctor* isIdAllowed = nullptr) const {
+        std::vector<std::vector<std::pair<dist_t, labeltype>>> results(nq);
+        size_t query_stride = query_size ? query_size : data_size_;
+        size_t n = cur_element_count;
+        if (n == 0 || nq == 0 || k == 0) return results;
+
+        if (num_threads == 0)
+            num_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        size_t query_tiles = (nq + kQueryTile - 1) / kQueryTile;
+        size_t tile = std::max<size_t>(kTileBytes / size_per_element_, 1);
+        size_t data_tiles = (n + tile - 1) / tile;
+        size_t slices = std::min(std::max<size_t>(num_threads / query_tiles, 1), data_tiles);
+        size_t tasks = query_tiles * slices;
+        num_threads = std::min(num_threads, tasks);
+
+        typedef std::pair<dist_t, labeltype> Entry;
+        std::vector<std::vector<Entry>> heaps(nq * slices);  // max-heaps, [query * slices + slice]
+
+        std::atomic<size_t> next_task{0};
+        std::exception_ptr last_exception = nullptr;
+        std::mutex last_except_mutex;
+
+        auto worker = [&]() {
+            try {
+                while (true) {
+                    size_t task = next_task.fetch_add(1);
+                    if (task >= tasks)
+                        break;
+                    size_t q_begin = (task / slices) * kQueryTile;
+                    size_t q_end = std::min(nq, q_begin + kQueryTile);
+                    size_t slice = task % slices;
+                    size_t begin = (data_tiles * slice / slices) * tile;
+                    size_t end = std::min(n, (data_tiles * (slice + 1) / slices) * tile);
+
+                    dist_t bound[kQueryTile];
+                    for (size_t q = q_begin; q < q_end; q++) {
+                        heaps[q * slices + slice].reserve(k + 1);
+                        bound[q - q_begin] = std::numeric_limits<dist_t>::max();
+                    }
+                    for (size_t t = begin; t < end; t += tile) {
+                        size_t t_end = std::min(end, t + tile);
+                        for (size_t q = q_begin; q < q_end; q++) {
+                            const void *query = (const char *) queries + q * query_stride;
+                            std::vector<Entry> &heap = heaps[q * slices + slice];
+                            dist_t &lastdist = bound[q - q_begin];
+                            for (size_t i = t; i < t_end; i++) {
+                                const char *elem = data_ + size_per_element_ * i;
+                                dist_t dist = fstquerydistfunc_(query, elem, dist_func_param_);
+                                if (heap.size() == k && dist >= lastdist)
+                                    continue;
+                                labeltype label = *((labeltype *) (elem + data_size_));
+                                if (isIdAllowed && !(*isIdAllowed)(label))
+                                    continue;
+                                heap.emplace_back(dist, label);
+                                std::push_heap(heap.begin(), heap.end());
+                                if (heap.size() > k) {
+                                    std::pop_heap(heap.begin(), heap.end());
+                                    heap.pop_back();
+                                }
+                                if (heap.size() == k)
+                                    lastdist = heap.front().first;
+                            }
+                        }
+                    }
                 }
+            } catch (...) {
+                std::unique_lock<std::mutex> lastExcepLock(last_except_mutex);
+                last_exception = std::current_exception();
+                // drain the counter so that the other workers stop too
+                next_task = tasks;
             }
+        };
+
+        if (num_threads == 1) {
+            worker();
+        } else {
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < num_threads; t++)
+                threads.emplace_back(worker);
+            for (auto &thread : threads)
+                thread.join();
         }
-        return topResults;
+        if (last_exception)
+            std::rethrow_exception(last_exception);
+
+        for (size_t q = 0; q < nq; q++) {
+            auto &out = results[q];
+            for (size_t s = 0; s < slices; s++) {
+                auto &heap = heaps[q * slices + s];
+                out.insert(out.end(), heap.begin(), heap.end());
+                std::vector<Entry>().swap(heap);
+            }
+            size_t m = std::min(k, out.size());
+            std::partial_sort(out.begin(), out.begin() + m, out.end());
+            out.resize(m);
+        }
+        return results;
     }
 
 
@@ -159,9 +271,12 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
 
         data_size_ = s->get_data_size();
         fstdistfunc_ = s->get_dist_func();
+        fstquerydistfunc_ = s->get_query_dist_func();
         dist_func_param_ = s->get_dist_func_param();
         size_per_element_ = data_size_ + sizeof(labeltype);
-        data_ = (char *) malloc(maxelements_ * size_per_element_);
+        freeLarge(data_alloc_);
+        data_alloc_ = allocLarge(maxelements_ * size_per_element_, huge_pages_);
+        data_ = data_alloc_.ptr;
         if (data_ == nullptr)
             throw std::runtime_error("Not enough memory: loadIndex failed to allocate data");
 
@@ -9,6 +9,17 @@
 #include <unordered_set>
 #include <list>
 #include <memory>
+#include <chrono>
+#include <thread>
+#include <exception>
+#include <fstream>
+#if defined(__unix__) || defined(__APPLE__)
+#define HNSWLIB_HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace hnswlib {
 typedef unsigned int tableint;
@@ -48,12 +59,15 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     size_t offsetData_{0}, offsetLevel0_{0}, label_offset_{ 0 };
 
     char *data_level0_memory_{nullptr};
+    LargeAllocation level0_alloc_;  // owns data_level0_memory_ unless it points into mmap_base_
+    bool huge_pages_{false};        // back level 0 with 2 MB pages, see allocLarge
     char **linkLists_{nullptr};
     std::vector<int> element_levels_;  // keeps level of each element
 
     size_t data_size_{0};
 
     DISTFUNC<dist_t> fstdistfunc_;
+    DISTFUNC<dist_t> fstquerydistfunc_;  // query vs stored element, see SpaceInterface::get_query_dist_func
     void *dist_func_param_{nullptr};
 
     mutable std::mutex label_lookup_lock;  // lock for label_lookup_
@@ -70,6 +84,14 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     std::mutex deleted_elements_lock;  // lock for deleted_elements
     std::unordered_set<tableint> deleted_elements;  // contains internal ids of deleted elements
 
+    // Set by loadIndexMmap: level 0 and the upper link lists point into this read-only mapping
+    char *mmap_base_{nullptr};
+    size_t mmap_size_{0};
+
+    // Page-aligned file layout written by saveIndexPageAligned
+    static constexpr char PAGE_ALIGNED_MAGIC[8] = {'H', 'N', 'S', 'W', 'P', 'A', '0', '1'};
+    static const size_t PAGE_ALIGNED_ALIGNMENT = 4096;
+
 
     HierarchicalNSW(SpaceInterface<dist_t> *s) {
     }
@@ -80,8 +102,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         const std::string &location,
         bool nmslib = false,
         size_t max_elements = 0,
-        bool allow_replace_deleted = false)
-        : allow_replace_deleted_(allow_replace_deleted) {
+        bool allow_replace_deleted = false,
+        bool huge_pages = false)
+        : huge_pages_(huge_pages),
+            allow_replace_deleted_(allow_replace_deleted) {
         loadIndex(location, s, max_elements);
     }
 
@@ -92,15 +116,18 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         size_t M = 16,
         size_t ef_construction = 200,
         size_t random_seed = 100,
-        bool allow_replace_deleted = false)
+        bool allow_replace_deleted = false,
+        bool huge_pages = false)
         : label_op_locks_(MAX_LABEL_OPERATION_LOCKS),
             link_list_locks_(max_elements),
+            huge_pages_(huge_pages),
             element_levels_(max_elements),
             allow_replace_deleted_(allow_replace_deleted) {
         max_elements_ = max_elements;
         num_deleted_ = 0;
         data_size_ = s->get_data_size();
         fstdistfunc_ = s->get_dist_func();
+        fstquerydistfunc_ = s->get_query_dist_func();
         dist_func_param_ = s->get_dist_func_param();
         if ( M <= 10000 ) {
             M_ = M;
@@ -123,7 +150,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         label_offset_ = size_links_level0_ + data_size_;
         offsetLevel0_ = 0;
 
-        data_level0_memory_ = (char *) malloc(max_elements_ * size_data_per_element_);
+        level0_alloc_ = allocLarge(max_elements_ * size_data_per_element_, huge_pages_);
+        data_level0_memory_ = level0_alloc_.ptr;
         if (data_level0_memory_ == nullptr)
             throw std::runtime_error("Not enough memory");
 
@@ -149,12 +177,21 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
     void clear() {
-        free(data_level0_memory_);
-        data_level0_memory_ = nullptr;
-        for (tableint i = 0; i < cur_element_count; i++) {
-            if (element_levels_[i] > 0)
-                free(linkLists_[i]);
+        if (mmap_base_) {
+#ifdef HNSWLIB_HAVE_MMAP
+            munmap(mmap_base_, mmap_size_);
+#endif
+            mmap_base_ = nullptr;
+            mmap_size_ = 0;
+            level0_alloc_ = LargeAllocation();
+        } else {
+            freeLarge(level0_alloc_);
+            for (tableint i = 0; i < cur_element_count; i++) {
+                if (element_levels_[i] > 0)
+                    free(linkLists_[i]);
+            }
         }
+        data_level0_memory_ = nullptr;
         free(linkLists_);
         linkLists_ = nullptr;
         cur_element_count = 0;
@@ -313,7 +350,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         const void *data_point,
         size_t ef,
         BaseFilterFunctor* isIdAllowed = nullptr,
-        BaseSearchStopCondition<dist_t>* stop_condition = nullptr) const {
+        BaseSearchStopCondition<dist_t>* stop_condition = nullptr,
+        SearchStats* stats = nullptr) const {
         VisitedList *vl = visited_list_pool_->getFreeVisitedList();
         vl_type *visited_array = vl->mass;
         vl_type visited_array_tag = vl->curV;
@@ -325,7 +363,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         if (bare_bone_search || 
             (!isMarkedDeleted(ep_id) && ((!isIdAllowed) || (*isIdAllowed)(getExternalLabel(ep_id))))) {
             char* ep_data = getDataByInternalId(ep_id);
-            dist_t dist = fstdistfunc_(data_point, ep_data, dist_func_param_);
+            dist_t dist = fstquerydistfunc_(data_point, ep_data, dist_func_param_);
             lowerBound = dist;
             top_candidates.emplace(dist, ep_id);
             if (!bare_bone_search && stop_condition) {
@@ -339,6 +377,13 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
         visited_array[ep_id] = visited_array_tag;
 
+        // counted locally and published once per query, the shared atomics are not touched per hop
+        size_t hops = 0;
+        size_t distance_computations = 0;
+        size_t visited = 1;
+        uint64_t distance_ns = 0;
+        const bool timing = collect_metrics && stats && stats->timing;
+
         while (!candidate_set.empty()) {
             std::pair<dist_t, tableint> current_node_pair = candidate_set.top();
             dist_t candidate_dist = -current_node_pair.first;
@@ -363,8 +408,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             size_t size = getListCount((linklistsizeint*)data);
 //                bool cur_node_deleted = isMarkedDeleted(current_node_id);
             if (collect_metrics) {
-                metric_hops++;
-                metric_distance_computations+=size;
+                hops++;
+                distance_computations += size;
             }
 
 #ifdef USE_SSE
@@ -386,7 +431,16 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                     visited_array[candidate_id] = visited_array_tag;
 
                     char *currObj1 = (getDataByInternalId(candidate_id));
-                    dist_t dist = fstdistfunc_(data_point, currObj1, dist_func_param_);
+                    dist_t dist;
+                    if (collect_metrics && timing) {
+                        auto t0 = std::chrono::steady_clock::now();
+                        dist = fstquerydistfunc_(data_point, currObj1, dist_func_param_);
+                        distance_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - t0).count();
+                    } else {
+                        dist = fstquerydistfunc_(data_point, currObj1, dist_func_param_);
+                    }
+                    if (collect_metrics) visited++;
 
                     bool flag_consider_candidate;
                     if (!bare_bone_search && stop_condition) {
@@ -436,6 +490,16 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         }
 
         visited_list_pool_->releaseVisitedList(vl);
+        if (collect_metrics) {
+            metric_hops += hops;
+            metric_distance_computations += distance_computations;
+            if (stats) {
+                stats->hops += hops;
+                stats->distance_computations += distance_computations;
+                stats->visited += visited;
+                stats->distance_ns += distance_ns;
+            }
+        }
         return top_candidates;
     }
 
@@ -630,7 +694,25 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
+    // Which allocation path backs level 0, the requested huge pages may have fallen back
+    MemoryBacking memoryBacking() const {
+        return level0_alloc_.backing;
+    }
+
+
+    bool isReadOnly() const {
+        return mmap_base_ != nullptr;
+    }
+
+
+    void checkWritable() const {
+        if (isReadOnly())
+            throw std::runtime_error("Index is loaded read-only with loadIndexMmap");
+    }
+
+
     void resizeIndex(size_t new_max_elements) {
+        checkWritable();
         if (new_max_elements < cur_element_count)
             throw std::runtime_error("Cannot resize, max element is less than the current number of elements");
 
@@ -641,10 +723,9 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         std::vector<std::mutex>(new_max_elements).swap(link_list_locks_);
 
         // Reallocate base layer
-        char * data_level0_memory_new = (char *) realloc(data_level0_memory_, new_max_elements * size_data_per_element_);
-        if (data_level0_memory_new == nullptr)
+        if (!reallocLarge(level0_alloc_, new_max_elements * size_data_per_element_, huge_pages_))
             throw std::runtime_error("Not enough memory: resizeIndex failed to allocate base layer");
-        data_level0_memory_ = data_level0_memory_new;
+        data_level0_memory_ = level0_alloc_.ptr;
 
         // Reallocate all other layers
         char ** linkLists_new = (char **) realloc(linkLists_, sizeof(void *) * new_max_elements);
@@ -720,6 +801,11 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             throw std::runtime_error("Cannot open file");
 
         clear();
+        if (isPageAlignedIndex(location)) {
+            input.close();
+            loadIndexPageAligned(location, s, max_elements_i);
+            return;
+        }
         // get file size:
         input.seekg(0, input.end);
         std::streampos total_filesize = input.tellg();
@@ -747,6 +833,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
         data_size_ = s->get_data_size();
         fstdistfunc_ = s->get_dist_func();
+        fstquerydistfunc_ = s->get_query_dist_func();
         dist_func_param_ = s->get_dist_func_param();
 
         auto pos = input.tellg();
@@ -774,7 +861,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
         input.seekg(pos, input.beg);
 
-        data_level0_memory_ = (char *) malloc(max_elements * size_data_per_element_);
+        level0_alloc_ = allocLarge(max_elements * size_data_per_element_, huge_pages_);
+        data_level0_memory_ = level0_alloc_.ptr;
         if (data_level0_memory_ == nullptr)
             throw std::runtime_error("Not enough memory: loadIndex failed to allocate level0");
         input.read(data_level0_memory_, cur_element_count * size_data_per_element_);
@@ -822,6 +910,278 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
+    static uint64_t alignToPage(uint64_t offset) {
+        return (offset + PAGE_ALIGNED_ALIGNMENT - 1) / PAGE_ALIGNED_ALIGNMENT * PAGE_ALIGNED_ALIGNMENT;
+    }
+
+
+    static void padStreamTo(std::ostream &output, uint64_t offset) {
+        static const char zeros[PAGE_ALIGNED_ALIGNMENT] = {};
+        uint64_t pos = (uint64_t) output.tellp();
+        while (pos < offset) {
+            size_t n = std::min<uint64_t>(offset - pos, sizeof(zeros));
+            output.write(zeros, n);
+            pos += n;
+        }
+    }
+
+
+    /*
+    * Saves the index in a layout that loadIndexMmap can map without copying. Every section starts on a page:
+    *   header: magic, the saveIndex header fields, then the section offsets below
+    *   level 0: cur_element_count * size_data_per_element_ bytes, as in memory
+    *   levels:  one int32 per element
+    *   links:   upper layer link lists of the elements with level > 0, concatenated in internal id order
+    */
+    void saveIndexPageAligned(const std::string &location) {
+        size_t count = cur_element_count;
+        uint64_t level0_offset = PAGE_ALIGNED_ALIGNMENT;
+        uint64_t levels_offset = alignToPage(level0_offset + count * size_data_per_element_);
+        uint64_t links_offset = alignToPage(levels_offset + count * sizeof(int32_t));
+        uint64_t links_bytes = 0;
+        for (size_t i = 0; i < count; i++)
+            links_bytes += size_links_per_element_ * element_levels_[i];
+        uint64_t file_size = links_offset + links_bytes;
+
+        std::ofstream output(location, std::ios::binary);
+        if (!output.is_open())
+            throw std::runtime_error("Cannot open file");
+
+        output.write(PAGE_ALIGNED_MAGIC, sizeof(PAGE_ALIGNED_MAGIC));
+        writeBinaryPOD(output, offsetLevel0_);
+        writeBinaryPOD(output, max_elements_);
+        writeBinaryPOD(output, count);
+        writeBinaryPOD(output, size_data_per_element_);
+        writeBinaryPOD(output, label_offset_);
+        writeBinaryPOD(output, offsetData_);
+        writeBinaryPOD(output, maxlevel_);
+        writeBinaryPOD(output, enterpoint_node_);
+        writeBinaryPOD(output, maxM_);
+        writeBinaryPOD(output, maxM0_);
+        writeBinaryPOD(output, M_);
+        writeBinaryPOD(output, mult_);
+        writeBinaryPOD(output, ef_construction_);
+        writeBinaryPOD(output, level0_offset);
+        writeBinaryPOD(output, levels_offset);
+        writeBinaryPOD(output, links_offset);
+        writeBinaryPOD(output, links_bytes);
+        writeBinaryPOD(output, file_size);
+
+        padStreamTo(output, level0_offset);
+        output.write(data_level0_memory_, count * size_data_per_element_);
+
+        padStreamTo(output, levels_offset);
+        for (size_t i = 0; i < count; i++) {
+            int32_t level = element_levels_[i];
+            writeBinaryPOD(output, level);
+        }
+
+        padStreamTo(output, links_offset);
+        for (size_t i = 0; i < count; i++) {
+            if (element_levels_[i] > 0)
+                output.write(linkLists_[i], size_links_per_element_ * element_levels_[i]);
+        }
+        output.close();
+        if (!output)
+            throw std::runtime_error("Failed to write index");
+    }
+
+
+    static bool isPageAlignedIndex(const std::string &location) {
+        std::ifstream input(location, std::ios::binary);
+        char magic[sizeof(PAGE_ALIGNED_MAGIC)] = {};
+        input.read(magic, sizeof(magic));
+        return input && memcmp(magic, PAGE_ALIGNED_MAGIC, sizeof(magic)) == 0;
+    }
+
+
+    /*
+    * Maps an index written by saveIndexPageAligned read-only. Level 0 and the upper link lists are used
+    * in place, so loading costs one pass to rebuild the label map, and processes mapping the same file
+    * share its pages through the page cache. addPoint, markDelete and resizeIndex throw on such an index.
+    * populate pre-faults the whole mapping (MAP_POPULATE) instead of faulting pages in on first access.
+    */
+    void loadIndexMmap(const std::string &location, SpaceInterface<dist_t> *s, bool populate = false) {
+#ifndef HNSWLIB_HAVE_MMAP
+        throw std::runtime_error("loadIndexMmap is not supported on this platform");
+#else
+        clear();
+        char *base = nullptr;
+        size_t size = 0;
+        mapIndexFile(location, populate, base, size);
+        mmap_base_ = base;
+        mmap_size_ = size;
+
+        PageAlignedLayout layout = readPageAlignedHeader(base, size, s);
+        size_t count = layout.count;
+        // A mapped index cannot grow
+        setupPageAligned(count);
+        data_level0_memory_ = base + layout.level0_offset;
+        level0_alloc_.ptr = data_level0_memory_;
+        level0_alloc_.bytes = count * size_data_per_element_;
+        level0_alloc_.backing = MemoryBacking::Mapped;
+
+        const int32_t *levels = (const int32_t *) (base + layout.levels_offset);
+        char *links = base + layout.links_offset;
+        for (size_t i = 0; i < count; i++) {
+            element_levels_[i] = levels[i];
+            if (levels[i] > 0) {
+                linkLists_[i] = links;
+                links += size_links_per_element_ * levels[i];
+            } else {
+                linkLists_[i] = nullptr;
+            }
+        }
+        finishPageAlignedLoad(count);
+#endif
+    }
+
+    struct PageAlignedLayout {
+        size_t count;
+        uint64_t level0_offset;
+        uint64_t levels_offset;
+        uint64_t links_offset;
+        uint64_t links_bytes;
+        uint64_t file_size;
+    };
+
+#ifdef HNSWLIB_HAVE_MMAP
+    static void mapIndexFile(const std::string &location, bool populate, char *&base, size_t &size) {
+        int fd = open(location.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open file");
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        }
+        int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+        if (populate)
+            flags |= MAP_POPULATE;
+#endif
+        void *p = mmap(nullptr, st.st_size, PROT_READ, flags, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+            throw std::runtime_error("mmap failed for " + location);
+        base = (char *) p;
+        size = st.st_size;
+    }
+#endif
+
+    // Reads the header of a page-aligned index and sets the index parameters from it
+    PageAlignedLayout readPageAlignedHeader(const char *base, size_t size, SpaceInterface<dist_t> *s) {
+        if (size < PAGE_ALIGNED_ALIGNMENT || memcmp(base, PAGE_ALIGNED_MAGIC, sizeof(PAGE_ALIGNED_MAGIC)) != 0)
+            throw std::runtime_error("Index is not in the page-aligned layout");
+
+        const char *p = base + sizeof(PAGE_ALIGNED_MAGIC);
+        auto read = [&p](auto &value) {
+            memcpy(&value, p, sizeof(value));
+            p += sizeof(value);
+        };
+        PageAlignedLayout layout;
+        read(offsetLevel0_);
+        read(max_elements_);
+        read(layout.count);
+        read(size_data_per_element_);
+        read(label_offset_);
+        read(offsetData_);
+        read(maxlevel_);
+        read(enterpoint_node_);
+        read(maxM_);
+        read(maxM0_);
+        read(M_);
+        read(mult_);
+        read(ef_construction_);
+        read(layout.level0_offset);
+        read(layout.levels_offset);
+        read(layout.links_offset);
+        read(layout.links_bytes);
+        read(layout.file_size);
+
+        if (layout.file_size != size ||
+            layout.level0_offset + layout.count * size_data_per_element_ > layout.levels_offset ||
+            layout.levels_offset + layout.count * sizeof(int32_t) > layout.links_offset ||
+            layout.links_offset + layout.links_bytes != size)
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+
+        data_size_ = s->get_data_size();
+        fstdistfunc_ = s->get_dist_func();
+        fstquerydistfunc_ = s->get_query_dist_func();
+        dist_func_param_ = s->get_dist_func_param();
+        size_links_per_element_ = maxM_ * sizeof(tableint) + sizeof(linklistsizeint);
+        size_links_level0_ = maxM0_ * sizeof(tableint) + sizeof(linklistsizeint);
+        revSize_ = 1.0 / mult_;
+        ef_ = 10;
+        return layout;
+    }
+
+    void setupPageAligned(size_t max_elements) {
+        max_elements_ = max_elements;
+        std::vector<std::mutex>(max_elements).swap(link_list_locks_);
+        std::vector<std::mutex>(MAX_LABEL_OPERATION_LOCKS).swap(label_op_locks_);
+        visited_list_pool_.reset(new VisitedListPool(1, max_elements));
+        linkLists_ = (char **) malloc(sizeof(void *) * max_elements);
+        if (linkLists_ == nullptr)
+            throw std::runtime_error("Not enough memory: loadIndex failed to allocate linklists");
+        element_levels_ = std::vector<int>(max_elements);
+    }
+
+    void finishPageAlignedLoad(size_t count) {
+        cur_element_count = count;
+        for (size_t i = 0; i < count; i++) {
+            label_lookup_[getExternalLabel(i)] = i;
+            if (isMarkedDeleted(i)) {
+                num_deleted_ += 1;
+                if (allow_replace_deleted_) deleted_elements.insert(i);
+            }
+        }
+    }
+
+    // Copying load of a page-aligned index, the result is writable like one read by loadIndex
+    void loadIndexPageAligned(const std::string &location, SpaceInterface<dist_t> *s, size_t max_elements_i) {
+#ifndef HNSWLIB_HAVE_MMAP
+        throw std::runtime_error("Page-aligned indexes are not supported on this platform");
+#else
+        char *base = nullptr;
+        size_t size = 0;
+        mapIndexFile(location, false, base, size);
+        try {
+            PageAlignedLayout layout = readPageAlignedHeader(base, size, s);
+            size_t count = layout.count;
+            setupPageAligned(std::max(max_elements_i, count));
+
+            level0_alloc_ = allocLarge(max_elements_ * size_data_per_element_, huge_pages_);
+            data_level0_memory_ = level0_alloc_.ptr;
+            if (data_level0_memory_ == nullptr)
+                throw std::runtime_error("Not enough memory: loadIndex failed to allocate level0");
+            memcpy(data_level0_memory_, base + layout.level0_offset, count * size_data_per_element_);
+
+            const int32_t *levels = (const int32_t *) (base + layout.levels_offset);
+            const char *links = base + layout.links_offset;
+            for (size_t i = 0; i < count; i++) {
+                element_levels_[i] = levels[i];
+                if (levels[i] > 0) {
+                    size_t bytes = size_links_per_element_ * levels[i];
+                    linkLists_[i] = (char *) malloc(bytes);
+                    if (linkLists_[i] == nullptr)
+                        throw std::runtime_error("Not enough memory: loadIndex failed to allocate linklist");
+                    memcpy(linkLists_[i], links, bytes);
+                    links += bytes;
+                } else {
+                    linkLists_[i] = nullptr;
+                }
+            }
+            finishPageAlignedLoad(count);
+        } catch (...) {
+            munmap(base, size);
+            throw;
+        }
+        munmap(base, size);
+#endif
+    }
+
+
     template<typename data_t>
     std::vector<data_t> getDataByLabel(labeltype label) const {
         // lock all operations with element by label
@@ -851,6 +1211,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     * Marks an element with the given label deleted, does NOT really change the current graph.
     */
     void markDelete(labeltype label) {
+        checkWritable();
         // lock all operations with element by label
         std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
 
@@ -893,6 +1254,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     *  because elements marked as deleted can be completely removed by addPoint
     */
     void unmarkDelete(labeltype label) {
+        checkWritable();
         // lock all operations with element by label
         std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
 
@@ -952,6 +1314,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     * If replacement of deleted elements is enabled: replaces previously deleted point if any, updating it with new point
     */
     void addPoint(const void *data_point, labeltype label, bool replace_deleted = false) {
+        checkWritable();
         if ((allow_replace_deleted_ == false) && (replace_deleted == true)) {
             throw std::runtime_error("Replacement of deleted elements is disabled in constructor");
         }
@@ -1152,6 +1515,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     tableint addPoint(const void *data_point, labeltype label, int level) {
         tableint cur_c = 0;
+        int curlevel = 0;
         {
             // Checking if the element with the same label already exists
             // if so, updating it *instead* of creating a new element.
@@ -1181,10 +1545,11 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             cur_c = cur_element_count;
             cur_element_count++;
             label_lookup_[label] = cur_c;
+            // drawn under the table lock, level_generator_ is shared by concurrent inserts
+            curlevel = getRandomLevel(mult_);
         }
 
         std::unique_lock <std::mutex> lock_el(link_list_locks_[cur_c]);
-        int curlevel = getRandomLevel(mult_);
         if (level > 0)
             curlevel = level;
 
@@ -1269,11 +1634,44 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     std::priority_queue<std::pair<dist_t, labeltype >>
     searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr) const {
+        return searchKnn(query_data, k, isIdAllowed, nullptr);
+    }
+
+
+    /*
+    * Same as searchKnn, additionally accumulates the hops and distance computations
+    * of this query (upper layers and base layer) into *stats when it is not null.
+    */
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed, SearchStats* stats) const {
+        SearchParams params;
+        params.isIdAllowed = isIdAllowed;
+        params.stats = stats;
+        return searchKnn(query_data, k, params);
+    }
+
+
+    /*
+    * searchKnn with per-call parameters. params.ef overrides ef_ for this query only,
+    * which makes it safe to serve different ef values from concurrent threads.
+    */
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnn(const void *query_data, size_t k, const SearchParams &params) const {
+        BaseFilterFunctor* isIdAllowed = params.isIdAllowed;
+        SearchStats* stats = params.stats;
+        size_t ef = params.ef ? params.ef : ef_;
+
         std::priority_queue<std::pair<dist_t, labeltype >> result;
         if (cur_element_count == 0) return result;
 
+        const bool timing = stats && stats->timing;
+        std::chrono::steady_clock::time_point t_start;
+        if (timing) t_start = std::chrono::steady_clock::now();
+
         tableint currObj = enterpoint_node_;
-        dist_t curdist = fstdistfunc_(query_data, getDataByInternalId(enterpoint_node_), dist_func_param_);
+        dist_t curdist = fstquerydistfunc_(query_data, getDataByInternalId(enterpoint_node_), dist_func_param_);
+        size_t hops = 0;
+        size_t distance_computations = 1;
 
         for (int level = maxlevel_; level > 0; level--) {
             bool changed = true;
@@ -1283,15 +1681,15 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
                 data = (unsigned int *) get_linklist(currObj, level);
                 int size = getListCount(data);
-                metric_hops++;
-                metric_distance_computations+=size;
+                hops++;
+                distance_computations += size;
 
                 tableint *datal = (tableint *) (data + 1);
                 for (int i = 0; i < size; i++) {
                     tableint cand = datal[i];
                     if (cand < 0 || cand > max_elements_)
                         throw std::runtime_error("cand error");
-                    dist_t d = fstdistfunc_(query_data, getDataByInternalId(cand), dist_func_param_);
+                    dist_t d = fstquerydistfunc_(query_data, getDataByInternalId(cand), dist_func_param_);
 
                     if (d < curdist) {
                         curdist = d;
@@ -1302,14 +1700,38 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             }
         }
 
+        metric_hops += hops;
+        metric_distance_computations += distance_computations;
+        std::chrono::steady_clock::time_point t_base;
+        if (stats) {
+            stats->hops += hops;
+            stats->distance_computations += distance_computations;
+            if (timing) {
+                t_base = std::chrono::steady_clock::now();
+                stats->upper_layer_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(t_base - t_start).count();
+            }
+        }
+
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
         bool bare_bone_search = !num_deleted_ && !isIdAllowed;
         if (bare_bone_search) {
-            top_candidates = searchBaseLayerST<true>(
-                    currObj, query_data, std::max(ef_, k), isIdAllowed);
+            if (stats)
+                top_candidates = searchBaseLayerST<true, true>(
+                        currObj, query_data, std::max(ef, k), isIdAllowed, nullptr, stats);
+            else
+                top_candidates = searchBaseLayerST<true>(
+                        currObj, query_data, std::max(ef, k), isIdAllowed);
         } else {
-            top_candidates = searchBaseLayerST<false>(
-                    currObj, query_data, std::max(ef_, k), isIdAllowed);
+            if (stats)
+                top_candidates = searchBaseLayerST<false, true>(
+                        currObj, query_data, std::max(ef, k), isIdAllowed, nullptr, stats);
+            else
+                top_candidates = searchBaseLayerST<false>(
+                        currObj, query_data, std::max(ef, k), isIdAllowed);
+        }
+        if (timing) {
+            stats->base_layer_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - t_base).count();
         }
 
         while (top_candidates.size() > k) {
@@ -1333,7 +1755,9 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         if (cur_element_count == 0) return result;
 
         tableint currObj = enterpoint_node_;
-        dist_t curdist = fstdistfunc_(query_data, getDataByInternalId(enterpoint_node_), dist_func_param_);
+        dist_t curdist = fstquerydistfunc_(query_data, getDataByInternalId(enterpoint_node_), dist_func_param_);
+        size_t hops = 0;
+        size_t distance_computations = 1;
 
         for (int level = maxlevel_; level > 0; level--) {
             bool changed = true;
@@ -1343,15 +1767,15 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
                 data = (unsigned int *) get_linklist(currObj, level);
                 int size = getListCount(data);
-                metric_hops++;
-                metric_distance_computations+=size;
+                hops++;
+                distance_computations += size;
 
                 tableint *datal = (tableint *) (data + 1);
                 for (int i = 0; i < size; i++) {
                     tableint cand = datal[i];
                     if (cand < 0 || cand > max_elements_)
                         throw std::runtime_error("cand error");
-                    dist_t d = fstdistfunc_(query_data, getDataByInternalId(cand), dist_func_param_);
+                    dist_t d = fstquerydistfunc_(query_data, getDataByInternalId(cand), dist_func_param_);
 
                     if (d < curdist) {
                         curdist = d;
@@ -1362,13 +1786,17 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             }
         }
 
+        metric_hops += hops;
+        metric_distance_computations += distance_computations;
+
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
         top_candidates = searchBaseLayerST<false>(currObj, query_data, 0, isIdAllowed, &stop_condition);
 
+        // top_candidates holds internal ids; callers get labels, as from searchKnn
         size_t sz = top_candidates.size();
         result.resize(sz);
         while (!top_candidates.empty()) {
-            result[--sz] = top_candidates.top();
+            result[--sz] = std::make_pair(top_candidates.top().first, getExternalLabel(top_candidates.top().second));
             top_candidates.pop();
         }
 
@@ -1378,6 +1806,232 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
+    /*
+    * Greedy descent through the upper layers, returns the base layer entry point for query_data.
+    */
+    tableint searchUpperLayers(const void *query_data) const {
+        tableint currObj = enterpoint_node_;
+        dist_t curdist = fstquerydistfunc_(query_data, getDataByInternalId(enterpoint_node_), dist_func_param_);
+
+        for (int level = maxlevel_; level > 0; level--) {
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                unsigned int *data = (unsigned int *) get_linklist(currObj, level);
+                int size = getListCount(data);
+
+                tableint *datal = (tableint *) (data + 1);
+                for (int i = 0; i < size; i++) {
+                    tableint cand = datal[i];
+                    if (cand < 0 || cand > max_elements_)
+                        throw std::runtime_error("cand error");
+                    dist_t d = fstquerydistfunc_(query_data, getDataByInternalId(cand), dist_func_param_);
+
+                    if (d < curdist) {
+                        curdist = d;
+                        currObj = cand;
+                        changed = true;
+                    }
+                }
+            }
+        }
+        return currObj;
+    }
+
+
+    // State of one in-flight query of searchKnnBatch, buffers are reused across the queries of a worker
+    struct BatchQueryState {
+        const void *query{nullptr};
+        size_t index{0};
+        VisitedList *vl{nullptr};
+        std::vector<std::pair<dist_t, tableint>> top_candidates;  // max-heap on distance
+        std::vector<std::pair<dist_t, tableint>> candidate_set;   // max-heap on -distance
+        dist_t lowerBound{0};
+        linklistsizeint *pending{nullptr};  // link list selected and prefetched, not yet expanded
+        bool done{true};
+    };
+
+
+    void startBatchQuery(BatchQueryState &st, tableint ep_id) const {
+        st.top_candidates.clear();
+        st.candidate_set.clear();
+        st.pending = nullptr;
+        st.done = false;
+        st.vl->reset();
+
+        if (!isMarkedDeleted(ep_id)) {
+            dist_t dist = fstquerydistfunc_(st.query, getDataByInternalId(ep_id), dist_func_param_);
+            st.lowerBound = dist;
+            st.top_candidates.emplace_back(dist, ep_id);
+            st.candidate_set.emplace_back(-dist, ep_id);
+        } else {
+            st.lowerBound = std::numeric_limits<dist_t>::max();
+            st.candidate_set.emplace_back(-st.lowerBound, ep_id);
+        }
+        st.vl->mass[ep_id] = st.vl->curV;
+    }
+
+
+    /*
+    * Pops the next candidate of the query and prefetches its neighbours (link list, visited
+    * marks and vectors). The neighbours are expanded on the next round, after the other
+    * queries of the group had their turn. Returns false when the search is finished.
+    */
+    bool selectBatchCandidate(BatchQueryState &st, size_t ef) const {
+        if (st.candidate_set.empty())
+            return false;
+        std::pair<dist_t, tableint> current_node_pair = st.candidate_set.front();
+        if (-current_node_pair.first > st.lowerBound && st.top_candidates.size() == ef)
+            return false;
+        std::pop_heap(st.candidate_set.begin(), st.candidate_set.end(), CompareByFirst());
+        st.candidate_set.pop_back();
+
+        st.pending = get_linklist0(current_node_pair.second);
+#ifdef USE_SSE
+        size_t size = getListCount(st.pending);
+        tableint *datal = (tableint *) (st.pending + 1);
+        for (size_t j = 0; j < size; j++) {
+            _mm_prefetch((char *) (st.vl->mass + datal[j]), _MM_HINT_T0);
+            _mm_prefetch(getDataByInternalId(datal[j]), _MM_HINT_T0);
+        }
+#endif
+        return true;
+    }
+
+
+    void expandBatchCandidate(BatchQueryState &st, size_t ef) const {
+        vl_type *visited_array = st.vl->mass;
+        vl_type visited_array_tag = st.vl->curV;
+        size_t size = getListCount(st.pending);
+        tableint *datal = (tableint *) (st.pending + 1);
+        st.pending = nullptr;
+
+        for (size_t j = 0; j < size; j++) {
+            tableint candidate_id = datal[j];
+            if (visited_array[candidate_id] == visited_array_tag)
+                continue;
+            visited_array[candidate_id] = visited_array_tag;
+
+            dist_t dist = fstquerydistfunc_(st.query, getDataByInternalId(candidate_id), dist_func_param_);
+            if (st.top_candidates.size() < ef || st.lowerBound > dist) {
+                st.candidate_set.emplace_back(-dist, candidate_id);
+                std::push_heap(st.candidate_set.begin(), st.candidate_set.end(), CompareByFirst());
+
+                if (!num_deleted_ || !isMarkedDeleted(candidate_id)) {
+                    st.top_candidates.emplace_back(dist, candidate_id);
+                    std::push_heap(st.top_candidates.begin(), st.top_candidates.end(), CompareByFirst());
+                }
+                if (st.top_candidates.size() > ef) {
+                    std::pop_heap(st.top_candidates.begin(), st.top_candidates.end(), CompareByFirst());
+                    st.top_candidates.pop_back();
+                }
+                if (!st.top_candidates.empty())
+                    st.lowerBound = st.top_candidates.front().first;
+            }
+        }
+    }
+
+
+    /*
+    * Searches nq queries stored back to back (data_size_ bytes each) and returns the k nearest
+    * neighbours of every query, closer first. ef == 0 uses ef_, num_threads == 0 uses all cores.
+    * Quantized spaces take queries of a different size than the stored elements, pass their
+    * get_query_size() as query_size (0 means data_size_).
+    *
+    * Workers claim groups of queries from a shared counter, so fast threads keep taking work
+    * until the batch is drained. Each worker keeps its VisitedLists and candidate buffers for
+    * the whole batch. With interleave > 1 a worker advances that many queries in lock-step
+    * through the base layer: the neighbours of one query are prefetched while the others are
+    * being expanded, which hides most of the memory latency of the graph walk.
+    */
+    std::vector<std::vector<std::pair<dist_t, labeltype>>>
+    searchKnnBatch(const void *queries, size_t nq, size_t k, size_t ef = 0,
+                   size_t num_threads = 0, size_t interleave = 1, size_t query_size = 0) const {
+        std::vector<std::vector<std::pair<dist_t, labeltype>>> results(nq);
+        size_t query_stride = query_size ? query_size : data_size_;
+        if (cur_element_count == 0 || nq == 0) return results;
+
+        size_t ef_search = std::max(ef ? ef : ef_, k);
+        size_t group = std::max<size_t>(interleave, 1);
+        if (num_threads == 0)
+            num_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        num_threads = std::min(num_threads, (nq + group - 1) / group);
+
+        std::atomic<size_t> next_query{0};
+        std::exception_ptr last_exception = nullptr;
+        std::mutex last_except_mutex;
+
+        auto worker = [&]() {
+            std::vector<BatchQueryState> states(group);
+            for (auto &st : states)
+                st.vl = visited_list_pool_->getFreeVisitedList();
+            try {
+                while (true) {
+                    size_t begin = next_query.fetch_add(group);
+                    if (begin >= nq)
+                        break;
+                    size_t end = std::min(nq, begin + group);
+                    size_t active = end - begin;
+
+                    for (size_t i = begin; i < end; i++) {
+                        BatchQueryState &st = states[i - begin];
+                        st.index = i;
+                        st.query = (const char *) queries + i * query_stride;
+                        startBatchQuery(st, searchUpperLayers(st.query));
+                        if (!selectBatchCandidate(st, ef_search)) {
+                            st.done = true;
+                            active--;
+                        }
+                    }
+
+                    while (active) {
+                        for (size_t g = 0; g < end - begin; g++) {
+                            BatchQueryState &st = states[g];
+                            if (st.done)
+                                continue;
+                            expandBatchCandidate(st, ef_search);
+                            if (!selectBatchCandidate(st, ef_search)) {
+                                st.done = true;
+                                active--;
+                            }
+                        }
+                    }
+
+                    for (size_t g = 0; g < end - begin; g++) {
+                        BatchQueryState &st = states[g];
+                        std::sort_heap(st.top_candidates.begin(), st.top_candidates.end(), CompareByFirst());
+                        size_t n = std::min(k, st.top_candidates.size());
+                        auto &out = results[st.index];
+                        out.reserve(n);
+                        for (size_t i = 0; i < n; i++)
+                            out.emplace_back(st.top_candidates[i].first, getExternalLabel(st.top_candidates[i].second));
+                    }
+                }
+            } catch (...) {
+                std::unique_lock<std::mutex> lastExcepLock(last_except_mutex);
+                last_exception = std::current_exception();
+                // drain the counter so that the other workers stop too
+                next_query = nq;
+            }
+            for (auto &st : states)
+                visited_list_pool_->releaseVisitedList(st.vl);
+        };
+
+        if (num_threads == 1) {
+            worker();
+        } else {
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < num_threads; t++)
+                threads.emplace_back(worker);
+            for (auto &thread : threads)
+                thread.join();
+        }
+        if (last_exception)
+            std::rethrow_exception(last_exception);
+        return results;
+    }
+
+
     void checkIntegrity() {
         int connections_checked = 0;
         std::vector <int > inbound_connections_num(cur_element_count, 0);
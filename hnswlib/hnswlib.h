@@ -11,14 +11,60 @@
 #ifndef NO_MANUAL_VECTORIZATION
 #if (defined(__SSE__) || _M_IX86_FP > 0 || defined(_M_AMD64) || defined(_M_X64))
 #define USE_SSE
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(HNSWLIB_NO_RUNTIME_DISPATCH)
+// GCC and Clang compile every kernel into the binary with target attributes, whatever -march says;
+// the spaces pick one at construction with AVXCapable()/AVX2Capable()/AVX512Capable(), so a single
+// build runs the widest kernels each machine supports. Define HNSWLIB_NO_RUNTIME_DISPATCH to go back
+// to selecting them from the compiler flags only.
+#define HNSWLIB_RUNTIME_DISPATCH
+#define USE_AVX
+#define USE_AVX2
+#define USE_AVX512
+#define USE_AVX512BW
+#define USE_AVX512VNNI
+#else
 #ifdef __AVX__
 #define USE_AVX
+#if defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+#define USE_AVX2
+#endif
 #ifdef __AVX512F__
 #define USE_AVX512
+#ifdef __AVX512BW__
+#define USE_AVX512BW
+#ifdef __AVX512VNNI__
+#define USE_AVX512VNNI
+#endif
 #endif
 #endif
 #endif
 #endif
+#endif
+#endif
+
+// Instruction sets a kernel is compiled for. Empty unless kernels are dispatched at runtime, in which
+// case the kernel may only be called after the matching *Capable() check.
+#if defined(HNSWLIB_RUNTIME_DISPATCH)
+#define HNSWLIB_TARGET_AVX __attribute__((target("avx")))
+#define HNSWLIB_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define HNSWLIB_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma,f16c")))
+#define HNSWLIB_TARGET_AVX512BW __attribute__((target("avx512f,avx512bw,avx2,fma")))
+#define HNSWLIB_TARGET_AVX512VNNI __attribute__((target("avx512f,avx512bw,avx512vnni,avx2,fma")))
+#else
+#define HNSWLIB_TARGET_AVX
+#define HNSWLIB_TARGET_AVX2
+#define HNSWLIB_TARGET_AVX512
+#define HNSWLIB_TARGET_AVX512BW
+#define HNSWLIB_TARGET_AVX512VNNI
+#endif
+
+// Unroll factor for loops with a compile-time trip count. Unrolling the long ones completely makes GCC
+// hoist every load ahead of the arithmetic and spill the 16 xmm/ymm registers to the stack.
+#if defined(__GNUC__)
+#define HNSWLIB_UNROLL _Pragma("GCC unroll 8")
+#else
+#define HNSWLIB_UNROLL
+#endif
 
 #if defined(USE_AVX) || defined(USE_SSE)
 #ifdef _MSC_VER
@@ -114,12 +160,43 @@ static bool AVX512Capable() {
     }
     return HW_AVX512F && avx512Supported;
 }
+
+// The checks below assume AVXCapable()/AVX512Capable() already confirmed OS support for the registers.
+// AVX2 kernels also use FMA and F16C, which every AVX2 CPU in practice has, but check them anyway.
+static bool AVX2Capable() {
+    if (!AVXCapable()) return false;
+
+    int cpuInfo[4];
+    cpuid(cpuInfo, 1, 0);
+    bool fma_f16c = (cpuInfo[2] & ((int)1 << 12)) != 0 && (cpuInfo[2] & ((int)1 << 29)) != 0;
+    cpuid(cpuInfo, 0, 0);
+    if (cpuInfo[0] < 0x00000007) return false;
+    cpuid(cpuInfo, 0x00000007, 0);
+    return fma_f16c && (cpuInfo[1] & ((int)1 << 5)) != 0;
+}
+
+static bool AVX512BWCapable() {
+    if (!AVX512Capable()) return false;
+
+    int cpuInfo[4];
+    cpuid(cpuInfo, 0x00000007, 0);
+    return (cpuInfo[1] & ((int)1 << 30)) != 0;
+}
+
+static bool AVX512VNNICapable() {
+    if (!AVX512BWCapable()) return false;
+
+    int cpuInfo[4];
+    cpuid(cpuInfo, 0x00000007, 0);
+    return (cpuInfo[2] & ((int)1 << 11)) != 0;
+}
 #endif
 
 #include <queue>
 #include <vector>
 #include <iostream>
 #include <string.h>
+#include <stdint.h>
 
 namespace hnswlib {
 typedef size_t labeltype;
@@ -131,6 +208,28 @@ class BaseFilterFunctor {
     virtual ~BaseFilterFunctor() {};
 };
 
+// Per-query counters, filled by the search routines when the caller passes one in.
+// Kept on the caller's stack so that concurrent queries never share a cache line.
+struct SearchStats {
+    size_t hops{0};
+    size_t distance_computations{0};
+    size_t visited{0};  // base layer nodes whose distance was evaluated
+
+    // Wall-clock breakdown, only measured when timing is set (it costs two clock reads per distance)
+    bool timing{false};
+    uint64_t upper_layer_ns{0};
+    uint64_t base_layer_ns{0};
+    uint64_t distance_ns{0};
+};
+
+// Per-call search settings, so concurrent queries do not have to share setEf().
+// ef == 0 falls back to the index-wide value set with setEf().
+struct SearchParams {
+    size_t ef{0};
+    BaseFilterFunctor* isIdAllowed{nullptr};
+    SearchStats* stats{nullptr};
+};
+
 template<typename dist_t>
 class BaseSearchStopCondition {
  public:
@@ -178,8 +277,21 @@ class SpaceInterface {
 
     virtual DISTFUNC<MTYPE> get_dist_func() = 0;
 
+    // Distance between a query as passed to searchKnn and a stored element. Spaces that store a compressed
+    // form of the vectors (space_quant.h) compare the float32 query against the stored codes here, while
+    // get_dist_func compares two stored elements during construction.
+    virtual DISTFUNC<MTYPE> get_query_dist_func() {
+        return get_dist_func();
+    }
+
     virtual void *get_dist_func_param() = 0;
 
+    // Widest instruction set used by the distance kernels picked for this CPU and dim
+    // ("avx512", "avx2", "avx", "sse", "scalar"), for diagnostics
+    virtual const char *get_simd_level() {
+        return "unknown";
+    }
+
     virtual ~SpaceInterface() {}
 };
 
@@ -221,8 +333,11 @@ AlgorithmInterface<dist_t>::searchKnnCloserFirst(const void* query_data, size_t
 }
 }  // namespace hnswlib
 
+#include "large_alloc.h"
 #include "space_l2.h"
 #include "space_ip.h"
+#include "space_quant.h"
+#include "space_pq.h"
 #include "stop_condition.h"
 #include "bruteforce.h"
 #include "hnswalg.h"
\ No newline at end of file
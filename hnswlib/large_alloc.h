@@ -0,0 +1,116 @@
+#pragma once
+#include <stdlib.h>
+#include <algorithm>
+#include <string.h>
+#include <stdexcept>
+#include <fstream>
+#include <string>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace hnswlib {
+
+// How a large, randomly accessed buffer (level 0 memory, brute-force data) is backed.
+enum class MemoryBacking {
+    Malloc,           // plain malloc, 4 KB pages
+    HugeTLB,          // mmap(MAP_HUGETLB) from the reserved 2 MB huge page pool
+    TransparentHuge,  // 2 MB aligned allocation advised with madvise(MADV_HUGEPAGE)
+    Mapped            // read-only file mapping (HierarchicalNSW::loadIndexMmap)
+};
+
+inline const char *memoryBackingName(MemoryBacking backing) {
+    switch (backing) {
+        case MemoryBacking::HugeTLB: return "hugetlb";
+        case MemoryBacking::TransparentHuge: return "thp";
+        case MemoryBacking::Mapped: return "mmap";
+        default: return "malloc";
+    }
+}
+
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// A buffer from allocLarge. bytes is the allocated size, which is rounded up to HUGE_PAGE_SIZE for huge pages.
+struct LargeAllocation {
+    char *ptr{nullptr};
+    size_t bytes{0};
+    MemoryBacking backing{MemoryBacking::Malloc};
+};
+
+#if defined(__linux__)
+// madvise succeeds even when THP is switched off system-wide, so check the policy as well
+inline bool transparentHugePagesEnabled() {
+    std::ifstream f("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string policy;
+    std::getline(f, policy);
+    return f && policy.find("[never]") == std::string::npos;
+}
+#endif
+
+/*
+* Allocates bytes of uninitialized memory. With huge_pages it tries MAP_HUGETLB first, which needs
+* pages reserved in /proc/sys/vm/nr_hugepages, then a 2 MB aligned allocation with MADV_HUGEPAGE,
+* and falls back to malloc. The backing that was actually used is recorded in the result.
+*/
+inline LargeAllocation allocLarge(size_t bytes, bool huge_pages) {
+    LargeAllocation a;
+#if defined(__linux__)
+    if (huge_pages && bytes > 0) {
+        size_t rounded = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+#ifdef MAP_HUGETLB
+        void *p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            a.ptr = (char *) p;
+            a.bytes = rounded;
+            a.backing = MemoryBacking::HugeTLB;
+            return a;
+        }
+#endif
+        void *q = nullptr;
+        if (posix_memalign(&q, HUGE_PAGE_SIZE, rounded) == 0) {
+            a.ptr = (char *) q;
+            a.bytes = rounded;
+            if (transparentHugePagesEnabled() && madvise(q, rounded, MADV_HUGEPAGE) == 0)
+                a.backing = MemoryBacking::TransparentHuge;
+            return a;
+        }
+    }
+#endif
+    a.ptr = (char *) malloc(bytes);
+    a.bytes = bytes;
+    return a;
+}
+
+inline void freeLarge(LargeAllocation &a) {
+#if defined(__linux__)
+    if (a.backing == MemoryBacking::HugeTLB) {
+        munmap(a.ptr, a.bytes);
+    } else
+#endif
+    if (a.backing != MemoryBacking::Mapped) {
+        free(a.ptr);
+    }
+    a = LargeAllocation();
+}
+
+// Grows or shrinks a, keeping the first min(old, new) bytes. On failure a is left untouched and false is returned.
+inline bool reallocLarge(LargeAllocation &a, size_t bytes, bool huge_pages) {
+    if (a.backing == MemoryBacking::Malloc && !huge_pages) {
+        char *p = (char *) realloc(a.ptr, bytes);
+        if (p == nullptr) return false;
+        a.ptr = p;
+        a.bytes = bytes;
+        return true;
+    }
+    if (a.backing == MemoryBacking::HugeTLB || a.backing == MemoryBacking::TransparentHuge) {
+        if (bytes <= a.bytes) return true;  // still fits in the rounded allocation
+    }
+    LargeAllocation n = allocLarge(bytes, huge_pages);
+    if (n.ptr == nullptr) return false;
+    if (a.ptr) memcpy(n.ptr, a.ptr, std::min(a.bytes, bytes));
+    freeLarge(a);
+    a = n;
+    return true;
+}
+
+}  // namespace hnswlib
@@ -21,6 +21,7 @@ InnerProductDistance(const void *pVect1, const void *pVect2, const void *qty_ptr
 #if defined(USE_AVX)
 
 // Favor using AVX if available.
+HNSWLIB_TARGET_AVX
 static float
 InnerProductSIMD4ExtAVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float PORTABLE_ALIGN32 TmpRes[8];
@@ -143,6 +144,7 @@ InnerProductDistanceSIMD4ExtSSE(const void *pVect1v, const void *pVect2v, const
 
 #if defined(USE_AVX512)
 
+HNSWLIB_TARGET_AVX512
 static float
 InnerProductSIMD16ExtAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float PORTABLE_ALIGN64 TmpRes[16];
@@ -207,6 +209,7 @@ InnerProductDistanceSIMD16ExtAVX512(const void *pVect1v, const void *pVect2v, co
 
 #if defined(USE_AVX)
 
+HNSWLIB_TARGET_AVX
 static float
 InnerProductSIMD16ExtAVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float PORTABLE_ALIGN32 TmpRes[8];
@@ -339,44 +342,167 @@ InnerProductDistanceSIMD4ExtResiduals(const void *pVect1v, const void *pVect2v,
 }
 #endif
 
+// Fixed-dimension kernels, see L2SqrFixedAVX512 in space_l2.h
+#if defined(USE_AVX512)
+template<size_t DIM>
+HNSWLIB_TARGET_AVX512
+static float
+InnerProductDistanceFixedAVX512(const void *pVect1v, const void *pVect2v, const void *) {
+    static_assert(DIM % 32 == 0, "DIM must be a multiple of 32");
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+
+    HNSWLIB_UNROLL
+    for (size_t i = 0; i < DIM; i += 32) {
+        sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(pVect1 + i), _mm512_loadu_ps(pVect2 + i), sum0);
+        sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(pVect1 + i + 16), _mm512_loadu_ps(pVect2 + i + 16), sum1);
+    }
+    return 1.0f - _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+}
+#endif
+
+#if defined(USE_AVX)
+template<size_t DIM>
+HNSWLIB_TARGET_AVX
+static float
+InnerProductDistanceFixedAVX(const void *pVect1v, const void *pVect2v, const void *) {
+    static_assert(DIM % 32 == 0, "DIM must be a multiple of 32");
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    float PORTABLE_ALIGN32 TmpRes[8];
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps();
+    __m256 sum3 = _mm256_setzero_ps();
+
+    HNSWLIB_UNROLL
+    for (size_t i = 0; i < DIM; i += 32) {
+        sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(pVect1 + i), _mm256_loadu_ps(pVect2 + i)));
+        sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(pVect1 + i + 8), _mm256_loadu_ps(pVect2 + i + 8)));
+        sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(_mm256_loadu_ps(pVect1 + i + 16), _mm256_loadu_ps(pVect2 + i + 16)));
+        sum3 = _mm256_add_ps(sum3, _mm256_mul_ps(_mm256_loadu_ps(pVect1 + i + 24), _mm256_loadu_ps(pVect2 + i + 24)));
+    }
+
+    _mm256_store_ps(TmpRes, _mm256_add_ps(_mm256_add_ps(sum0, sum1), _mm256_add_ps(sum2, sum3)));
+    return 1.0f - (TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7]);
+}
+#endif
+
+#if defined(USE_SSE)
+template<size_t DIM>
+static float
+InnerProductDistanceFixedSSE(const void *pVect1v, const void *pVect2v, const void *) {
+    static_assert(DIM % 16 == 0, "DIM must be a multiple of 16");
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    float PORTABLE_ALIGN32 TmpRes[8];
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    __m128 sum2 = _mm_setzero_ps();
+    __m128 sum3 = _mm_setzero_ps();
+
+    HNSWLIB_UNROLL
+    for (size_t i = 0; i < DIM; i += 16) {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(pVect1 + i), _mm_loadu_ps(pVect2 + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(pVect1 + i + 4), _mm_loadu_ps(pVect2 + i + 4)));
+        sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_loadu_ps(pVect1 + i + 8), _mm_loadu_ps(pVect2 + i + 8)));
+        sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_loadu_ps(pVect1 + i + 12), _mm_loadu_ps(pVect2 + i + 12)));
+    }
+
+    _mm_store_ps(TmpRes, _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3)));
+    return 1.0f - (TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3]);
+}
+
+template<size_t DIM>
+static DISTFUNC<float> InnerProductDistanceFixedPick(const char **simd_level) {
+#if defined(USE_AVX512)
+    if (AVX512Capable()) {
+        *simd_level = "avx512";
+        return InnerProductDistanceFixedAVX512<DIM>;
+    }
+#endif
+#if defined(USE_AVX)
+    if (AVXCapable()) {
+        *simd_level = "avx";
+        return InnerProductDistanceFixedAVX<DIM>;
+    }
+#endif
+    *simd_level = "sse";
+    return InnerProductDistanceFixedSSE<DIM>;
+}
+
+// Kernel specialized for dim on this CPU, or nullptr if dim is not one of the sizes compiled in
+static DISTFUNC<float> InnerProductDistanceFixedDim(size_t dim, const char **simd_level) {
+    switch (dim) {
+        case 96: return InnerProductDistanceFixedPick<96>(simd_level);
+        case 128: return InnerProductDistanceFixedPick<128>(simd_level);
+        case 256: return InnerProductDistanceFixedPick<256>(simd_level);
+        case 384: return InnerProductDistanceFixedPick<384>(simd_level);
+        case 768: return InnerProductDistanceFixedPick<768>(simd_level);
+        case 1024: return InnerProductDistanceFixedPick<1024>(simd_level);
+        case 1536: return InnerProductDistanceFixedPick<1536>(simd_level);
+        default: return nullptr;
+    }
+}
+#endif
+
 class InnerProductSpace : public SpaceInterface<float> {
     DISTFUNC<float> fstdistfunc_;
     size_t data_size_;
     size_t dim_;
+    const char *simd_level_ = "scalar";
 
  public:
     InnerProductSpace(size_t dim) {
         fstdistfunc_ = InnerProductDistance;
 #if defined(USE_AVX) || defined(USE_SSE) || defined(USE_AVX512)
+        const char *simd16 = "sse";
+        const char *simd4 = "sse";
     #if defined(USE_AVX512)
         if (AVX512Capable()) {
             InnerProductSIMD16Ext = InnerProductSIMD16ExtAVX512;
             InnerProductDistanceSIMD16Ext = InnerProductDistanceSIMD16ExtAVX512;
+            simd16 = "avx512";
         } else if (AVXCapable()) {
             InnerProductSIMD16Ext = InnerProductSIMD16ExtAVX;
             InnerProductDistanceSIMD16Ext = InnerProductDistanceSIMD16ExtAVX;
+            simd16 = "avx";
         }
     #elif defined(USE_AVX)
         if (AVXCapable()) {
             InnerProductSIMD16Ext = InnerProductSIMD16ExtAVX;
             InnerProductDistanceSIMD16Ext = InnerProductDistanceSIMD16ExtAVX;
+            simd16 = "avx";
         }
     #endif
     #if defined(USE_AVX)
         if (AVXCapable()) {
             InnerProductSIMD4Ext = InnerProductSIMD4ExtAVX;
             InnerProductDistanceSIMD4Ext = InnerProductDistanceSIMD4ExtAVX;
+            simd4 = "avx";
         }
     #endif
 
-        if (dim % 16 == 0)
+        if (dim % 16 == 0) {
             fstdistfunc_ = InnerProductDistanceSIMD16Ext;
-        else if (dim % 4 == 0)
+            simd_level_ = simd16;
+        } else if (dim % 4 == 0) {
             fstdistfunc_ = InnerProductDistanceSIMD4Ext;
-        else if (dim > 16)
+            simd_level_ = simd4;
+        } else if (dim > 16) {
             fstdistfunc_ = InnerProductDistanceSIMD16ExtResiduals;
-        else if (dim > 4)
+            simd_level_ = simd16;
+        } else if (dim > 4) {
             fstdistfunc_ = InnerProductDistanceSIMD4ExtResiduals;
+            simd_level_ = simd4;
+        }
+    #if defined(USE_SSE)
+        if (DISTFUNC<float> fixed = InnerProductDistanceFixedDim(dim, &simd_level_)) {
+            fstdistfunc_ = fixed;
+        }
+    #endif
 #endif
         dim_ = dim;
         data_size_ = dim * sizeof(float);
@@ -394,7 +520,160 @@ class InnerProductSpace : public SpaceInterface<float> {
         return &dim_;
     }
 
+    const char *get_simd_level() {
+        return simd_level_;
+    }
+
 ~InnerProductSpace() {}
 };
 
+// Inner product over uint8 vectors. The distance is the negated product so that smaller is closer,
+// as with L2SpaceI the result is exact in int.
+static int
+InnerProductDistanceI(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    const unsigned char *a = (const unsigned char *) pVect1;
+    const unsigned char *b = (const unsigned char *) pVect2;
+
+    int res = 0;
+    for (size_t i = 0; i < qty; i++) res += a[i] * b[i];
+    return -res;
+}
+
+#if defined(USE_AVX2)
+
+HNSWLIB_TARGET_AVX2
+static int
+InnerProductDistanceISIMD32ExtAVX2(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty32 = qty >> 5 << 5;
+    const unsigned char *a = (const unsigned char *) pVect1;
+    const unsigned char *b = (const unsigned char *) pVect2;
+
+    __m256i sum = _mm256_setzero_si256();
+    for (size_t i = 0; i < qty32; i += 32) {
+        __m256i va = _mm256_loadu_si256((const __m256i *) (a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *) (b + i));
+        __m256i a_lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(va));
+        __m256i b_lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(vb));
+        __m256i a_hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(va, 1));
+        __m256i b_hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(vb, 1));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a_lo, b_lo));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a_hi, b_hi));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    int res = _mm_cvtsi128_si32(s);
+    for (size_t i = qty32; i < qty; i++) res += a[i] * b[i];
+    return -res;
+}
+
+#endif
+
+#if defined(USE_AVX512BW)
+
+HNSWLIB_TARGET_AVX512BW
+static int
+InnerProductDistanceISIMD64ExtAVX512(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty64 = qty >> 6 << 6;
+    const unsigned char *a = (const unsigned char *) pVect1;
+    const unsigned char *b = (const unsigned char *) pVect2;
+
+    __m512i sum = _mm512_setzero_si512();
+    for (size_t i = 0; i < qty64; i += 64) {
+        __m512i va = _mm512_loadu_si512((const void *) (a + i));
+        __m512i vb = _mm512_loadu_si512((const void *) (b + i));
+        __m512i a_lo = _mm512_cvtepu8_epi16(_mm512_castsi512_si256(va));
+        __m512i b_lo = _mm512_cvtepu8_epi16(_mm512_castsi512_si256(vb));
+        __m512i a_hi = _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(va, 1));
+        __m512i b_hi = _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(vb, 1));
+        sum = _mm512_add_epi32(sum, _mm512_madd_epi16(a_lo, b_lo));
+        sum = _mm512_add_epi32(sum, _mm512_madd_epi16(a_hi, b_hi));
+    }
+    int res = _mm512_reduce_add_epi32(sum);
+    for (size_t i = qty64; i < qty; i++) res += a[i] * b[i];
+    return -res;
+}
+
+#if defined(USE_AVX512VNNI)
+
+// vpdpbusd takes one signed operand, bytes above 127 would not fit, so this uses the 16-bit vpdpwssd
+HNSWLIB_TARGET_AVX512VNNI
+static int
+InnerProductDistanceISIMD64ExtAVX512VNNI(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty64 = qty >> 6 << 6;
+    const unsigned char *a = (const unsigned char *) pVect1;
+    const unsigned char *b = (const unsigned char *) pVect2;
+
+    __m512i sum = _mm512_setzero_si512();
+    for (size_t i = 0; i < qty64; i += 64) {
+        __m512i va = _mm512_loadu_si512((const void *) (a + i));
+        __m512i vb = _mm512_loadu_si512((const void *) (b + i));
+        sum = _mm512_dpwssd_epi32(sum, _mm512_cvtepu8_epi16(_mm512_castsi512_si256(va)),
+                                  _mm512_cvtepu8_epi16(_mm512_castsi512_si256(vb)));
+        sum = _mm512_dpwssd_epi32(sum, _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(va, 1)),
+                                  _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(vb, 1)));
+    }
+    int res = _mm512_reduce_add_epi32(sum);
+    for (size_t i = qty64; i < qty; i++) res += a[i] * b[i];
+    return -res;
+}
+
+#endif
+#endif
+
+class InnerProductSpaceI : public SpaceInterface<int> {
+    DISTFUNC<int> fstdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+    const char *simd_level_ = "scalar";
+
+ public:
+    InnerProductSpaceI(size_t dim) {
+        fstdistfunc_ = InnerProductDistanceI;
+#if defined(USE_AVX512BW)
+        if (AVX512BWCapable()) {
+            fstdistfunc_ = InnerProductDistanceISIMD64ExtAVX512;
+            simd_level_ = "avx512";
+#if defined(USE_AVX512VNNI)
+            if (AVX512VNNICapable()) {
+                fstdistfunc_ = InnerProductDistanceISIMD64ExtAVX512VNNI;
+                simd_level_ = "avx512vnni";
+            }
+#endif
+        } else
+#endif
+#if defined(USE_AVX2)
+        if (AVX2Capable()) {
+            fstdistfunc_ = InnerProductDistanceISIMD32ExtAVX2;
+            simd_level_ = "avx2";
+        }
+#endif
+        ;
+        dim_ = dim;
+        data_size_ = dim * sizeof(unsigned char);
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<int> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    const char *get_simd_level() {
+        return simd_level_;
+    }
+
+    ~InnerProductSpaceI() {}
+};
+
 }  // namespace hnswlib
\ No newline at end of file
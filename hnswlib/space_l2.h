@@ -22,6 +22,7 @@ L2Sqr(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
 #if defined(USE_AVX512)
 
 // Favor using AVX512 if available.
+HNSWLIB_TARGET_AVX512
 static float
 L2SqrSIMD16ExtAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float *pVect1 = (float *) pVect1v;
@@ -57,6 +58,7 @@ L2SqrSIMD16ExtAVX512(const void *pVect1v, const void *pVect2v, const void *qty_p
 #if defined(USE_AVX)
 
 // Favor using AVX if available.
+HNSWLIB_TARGET_AVX
 static float
 L2SqrSIMD16ExtAVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float *pVect1 = (float *) pVect1v;
@@ -205,33 +207,169 @@ L2SqrSIMD4ExtResiduals(const void *pVect1v, const void *pVect2v, const void *qty
 }
 #endif
 
+// Kernels for the common embedding sizes (96, 128, 256, 384, 768, 1024, 1536). The dimension is a
+// template parameter, so qty is never read and the loop has a constant trip count (unrolled completely up
+// to dim 256 with AVX-512, eight times beyond that); several accumulators keep the adds from waiting on
+// each other. L2Space picks them through L2SqrFixedDim().
+#if defined(USE_AVX512)
+template<size_t DIM>
+HNSWLIB_TARGET_AVX512
+static float
+L2SqrFixedAVX512(const void *pVect1v, const void *pVect2v, const void *) {
+    static_assert(DIM % 32 == 0, "DIM must be a multiple of 32");
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+
+    HNSWLIB_UNROLL
+    for (size_t i = 0; i < DIM; i += 32) {
+        __m512 diff0 = _mm512_sub_ps(_mm512_loadu_ps(pVect1 + i), _mm512_loadu_ps(pVect2 + i));
+        __m512 diff1 = _mm512_sub_ps(_mm512_loadu_ps(pVect1 + i + 16), _mm512_loadu_ps(pVect2 + i + 16));
+        sum0 = _mm512_fmadd_ps(diff0, diff0, sum0);
+        sum1 = _mm512_fmadd_ps(diff1, diff1, sum1);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+}
+#endif
+
+#if defined(USE_AVX)
+template<size_t DIM>
+HNSWLIB_TARGET_AVX
+static float
+L2SqrFixedAVX(const void *pVect1v, const void *pVect2v, const void *) {
+    static_assert(DIM % 32 == 0, "DIM must be a multiple of 32");
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    float PORTABLE_ALIGN32 TmpRes[8];
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps();
+    __m256 sum3 = _mm256_setzero_ps();
+
+    HNSWLIB_UNROLL
+    for (size_t i = 0; i < DIM; i += 32) {
+        __m256 diff0 = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + i), _mm256_loadu_ps(pVect2 + i));
+        __m256 diff1 = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + i + 8), _mm256_loadu_ps(pVect2 + i + 8));
+        __m256 diff2 = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + i + 16), _mm256_loadu_ps(pVect2 + i + 16));
+        __m256 diff3 = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + i + 24), _mm256_loadu_ps(pVect2 + i + 24));
+        sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(diff0, diff0));
+        sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(diff1, diff1));
+        sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(diff2, diff2));
+        sum3 = _mm256_add_ps(sum3, _mm256_mul_ps(diff3, diff3));
+    }
+
+    _mm256_store_ps(TmpRes, _mm256_add_ps(_mm256_add_ps(sum0, sum1), _mm256_add_ps(sum2, sum3)));
+    return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+}
+#endif
+
+#if defined(USE_SSE)
+template<size_t DIM>
+static float
+L2SqrFixedSSE(const void *pVect1v, const void *pVect2v, const void *) {
+    static_assert(DIM % 16 == 0, "DIM must be a multiple of 16");
+    const float *pVect1 = (const float *) pVect1v;
+    const float *pVect2 = (const float *) pVect2v;
+    float PORTABLE_ALIGN32 TmpRes[8];
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    __m128 sum2 = _mm_setzero_ps();
+    __m128 sum3 = _mm_setzero_ps();
+
+    HNSWLIB_UNROLL
+    for (size_t i = 0; i < DIM; i += 16) {
+        __m128 diff0 = _mm_sub_ps(_mm_loadu_ps(pVect1 + i), _mm_loadu_ps(pVect2 + i));
+        __m128 diff1 = _mm_sub_ps(_mm_loadu_ps(pVect1 + i + 4), _mm_loadu_ps(pVect2 + i + 4));
+        __m128 diff2 = _mm_sub_ps(_mm_loadu_ps(pVect1 + i + 8), _mm_loadu_ps(pVect2 + i + 8));
+        __m128 diff3 = _mm_sub_ps(_mm_loadu_ps(pVect1 + i + 12), _mm_loadu_ps(pVect2 + i + 12));
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(diff0, diff0));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(diff1, diff1));
+        sum2 = _mm_add_ps(sum2, _mm_mul_ps(diff2, diff2));
+        sum3 = _mm_add_ps(sum3, _mm_mul_ps(diff3, diff3));
+    }
+
+    _mm_store_ps(TmpRes, _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3)));
+    return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+}
+
+template<size_t DIM>
+static DISTFUNC<float> L2SqrFixedPick(const char **simd_level) {
+#if defined(USE_AVX512)
+    if (AVX512Capable()) {
+        *simd_level = "avx512";
+        return L2SqrFixedAVX512<DIM>;
+    }
+#endif
+#if defined(USE_AVX)
+    if (AVXCapable()) {
+        *simd_level = "avx";
+        return L2SqrFixedAVX<DIM>;
+    }
+#endif
+    *simd_level = "sse";
+    return L2SqrFixedSSE<DIM>;
+}
+
+// Kernel specialized for dim on this CPU, or nullptr if dim is not one of the sizes compiled in
+static DISTFUNC<float> L2SqrFixedDim(size_t dim, const char **simd_level) {
+    switch (dim) {
+        case 96: return L2SqrFixedPick<96>(simd_level);
+        case 128: return L2SqrFixedPick<128>(simd_level);
+        case 256: return L2SqrFixedPick<256>(simd_level);
+        case 384: return L2SqrFixedPick<384>(simd_level);
+        case 768: return L2SqrFixedPick<768>(simd_level);
+        case 1024: return L2SqrFixedPick<1024>(simd_level);
+        case 1536: return L2SqrFixedPick<1536>(simd_level);
+        default: return nullptr;
+    }
+}
+#endif
+
 class L2Space : public SpaceInterface<float> {
     DISTFUNC<float> fstdistfunc_;
     size_t data_size_;
     size_t dim_;
+    const char *simd_level_ = "scalar";
 
  public:
     L2Space(size_t dim) {
         fstdistfunc_ = L2Sqr;
 #if defined(USE_SSE) || defined(USE_AVX) || defined(USE_AVX512)
+        const char *simd16 = "sse";
     #if defined(USE_AVX512)
-        if (AVX512Capable())
+        if (AVX512Capable()) {
             L2SqrSIMD16Ext = L2SqrSIMD16ExtAVX512;
-        else if (AVXCapable())
+            simd16 = "avx512";
+        } else if (AVXCapable()) {
             L2SqrSIMD16Ext = L2SqrSIMD16ExtAVX;
+            simd16 = "avx";
+        }
     #elif defined(USE_AVX)
-        if (AVXCapable())
+        if (AVXCapable()) {
             L2SqrSIMD16Ext = L2SqrSIMD16ExtAVX;
+            simd16 = "avx";
+        }
     #endif
 
-        if (dim % 16 == 0)
+        if (dim % 16 == 0) {
             fstdistfunc_ = L2SqrSIMD16Ext;
-        else if (dim % 4 == 0)
+            simd_level_ = simd16;
+        } else if (dim % 4 == 0) {
             fstdistfunc_ = L2SqrSIMD4Ext;
-        else if (dim > 16)
+            simd_level_ = "sse";
+        } else if (dim > 16) {
             fstdistfunc_ = L2SqrSIMD16ExtResiduals;
-        else if (dim > 4)
+            simd_level_ = simd16;
+        } else if (dim > 4) {
             fstdistfunc_ = L2SqrSIMD4ExtResiduals;
+            simd_level_ = "sse";
+        }
+    #if defined(USE_SSE)
+        if (DISTFUNC<float> fixed = L2SqrFixedDim(dim, &simd_level_)) {
+            fstdistfunc_ = fixed;
+        }
+    #endif
 #endif
         dim_ = dim;
         data_size_ = dim * sizeof(float);
@@ -249,6 +387,10 @@ class L2Space : public SpaceInterface<float> {
         return &dim_;
     }
 
+    const char *get_simd_level() {
+        return simd_level_;
+    }
+
     ~L2Space() {}
 };
 
@@ -291,10 +433,99 @@ static int L2SqrI(const void* __restrict pVect1, const void* __restrict pVect2,
     return (res);
 }
 
+#if defined(USE_AVX2)
+
+// Bytes are widened to 16 bits, (a - b)^2 pairs are summed into 32-bit lanes by madd
+HNSWLIB_TARGET_AVX2
+static int
+L2SqrISIMD32ExtAVX2(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty32 = qty >> 5 << 5;
+    const unsigned char *a = (const unsigned char *) pVect1;
+    const unsigned char *b = (const unsigned char *) pVect2;
+
+    __m256i sum = _mm256_setzero_si256();
+    for (size_t i = 0; i < qty32; i += 32) {
+        __m256i va = _mm256_loadu_si256((const __m256i *) (a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *) (b + i));
+        __m256i d_lo = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(va)),
+                                        _mm256_cvtepu8_epi16(_mm256_castsi256_si128(vb)));
+        __m256i d_hi = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(va, 1)),
+                                        _mm256_cvtepu8_epi16(_mm256_extracti128_si256(vb, 1)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(d_lo, d_lo));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(d_hi, d_hi));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    int res = _mm_cvtsi128_si32(s);
+    for (size_t i = qty32; i < qty; i++) res += (a[i] - b[i]) * (a[i] - b[i]);
+    return res;
+}
+
+#endif
+
+#if defined(USE_AVX512BW)
+
+HNSWLIB_TARGET_AVX512BW
+static int
+L2SqrISIMD64ExtAVX512(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty64 = qty >> 6 << 6;
+    const unsigned char *a = (const unsigned char *) pVect1;
+    const unsigned char *b = (const unsigned char *) pVect2;
+
+    __m512i sum = _mm512_setzero_si512();
+    for (size_t i = 0; i < qty64; i += 64) {
+        __m512i va = _mm512_loadu_si512((const void *) (a + i));
+        __m512i vb = _mm512_loadu_si512((const void *) (b + i));
+        __m512i d_lo = _mm512_sub_epi16(_mm512_cvtepu8_epi16(_mm512_castsi512_si256(va)),
+                                        _mm512_cvtepu8_epi16(_mm512_castsi512_si256(vb)));
+        __m512i d_hi = _mm512_sub_epi16(_mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(va, 1)),
+                                        _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(vb, 1)));
+        sum = _mm512_add_epi32(sum, _mm512_madd_epi16(d_lo, d_lo));
+        sum = _mm512_add_epi32(sum, _mm512_madd_epi16(d_hi, d_hi));
+    }
+    int res = _mm512_reduce_add_epi32(sum);
+    for (size_t i = qty64; i < qty; i++) res += (a[i] - b[i]) * (a[i] - b[i]);
+    return res;
+}
+
+#if defined(USE_AVX512VNNI)
+
+// vpdpwssd fuses the madd and the accumulation of the AVX512 version
+HNSWLIB_TARGET_AVX512VNNI
+static int
+L2SqrISIMD64ExtAVX512VNNI(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty64 = qty >> 6 << 6;
+    const unsigned char *a = (const unsigned char *) pVect1;
+    const unsigned char *b = (const unsigned char *) pVect2;
+
+    __m512i sum = _mm512_setzero_si512();
+    for (size_t i = 0; i < qty64; i += 64) {
+        __m512i va = _mm512_loadu_si512((const void *) (a + i));
+        __m512i vb = _mm512_loadu_si512((const void *) (b + i));
+        __m512i d_lo = _mm512_sub_epi16(_mm512_cvtepu8_epi16(_mm512_castsi512_si256(va)),
+                                        _mm512_cvtepu8_epi16(_mm512_castsi512_si256(vb)));
+        __m512i d_hi = _mm512_sub_epi16(_mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(va, 1)),
+                                        _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(vb, 1)));
+        sum = _mm512_dpwssd_epi32(sum, d_lo, d_lo);
+        sum = _mm512_dpwssd_epi32(sum, d_hi, d_hi);
+    }
+    int res = _mm512_reduce_add_epi32(sum);
+    for (size_t i = qty64; i < qty; i++) res += (a[i] - b[i]) * (a[i] - b[i]);
+    return res;
+}
+
+#endif
+#endif
+
 class L2SpaceI : public SpaceInterface<int> {
     DISTFUNC<int> fstdistfunc_;
     size_t data_size_;
     size_t dim_;
+    const char *simd_level_ = "scalar";
 
  public:
     L2SpaceI(size_t dim) {
@@ -303,6 +534,26 @@ class L2SpaceI : public SpaceInterface<int> {
         } else {
             fstdistfunc_ = L2SqrI;
         }
+        // The SIMD kernels handle any dim, the tail is summed in scalar code
+#if defined(USE_AVX512BW)
+        if (AVX512BWCapable()) {
+            fstdistfunc_ = L2SqrISIMD64ExtAVX512;
+            simd_level_ = "avx512";
+#if defined(USE_AVX512VNNI)
+            if (AVX512VNNICapable()) {
+                fstdistfunc_ = L2SqrISIMD64ExtAVX512VNNI;
+                simd_level_ = "avx512vnni";
+            }
+#endif
+        } else
+#endif
+#if defined(USE_AVX2)
+        if (AVX2Capable()) {
+            fstdistfunc_ = L2SqrISIMD32ExtAVX2;
+            simd_level_ = "avx2";
+        }
+#endif
+        ;
         dim_ = dim;
         data_size_ = dim * sizeof(unsigned char);
     }
@@ -319,6 +570,10 @@ class L2SpaceI : public SpaceInterface<int> {
         return &dim_;
     }
 
+    const char *get_simd_level() {
+        return simd_level_;
+    }
+
     ~L2SpaceI() {}
 };
 }  // namespace hnswlib
\ No newline at end of file
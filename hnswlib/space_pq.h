@@ -0,0 +1,378 @@
+#pragma once
+#include "hnswlib.h"
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace hnswlib {
+
+// Product quantization: the vector is split into M sub-vectors of dim / M dimensions and each one is
+// replaced by the index of its nearest centroid out of PQ_KSUB, so an element takes M bytes.
+static const size_t PQ_KSUB = 256;
+
+// dim has to stay the first member, hnswlib reads the dimension through *(size_t *) dist_func_param
+struct PQParams {
+    size_t dim;
+    size_t M;
+    const float *sdc;  // M x PQ_KSUB x PQ_KSUB centroid to centroid distances, for code vs code
+};
+
+// Asymmetric distance: the query side is the M x PQ_KSUB lookup table built by PQSpace::prepareQuery
+static float
+PQAdc(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const float *lut = (const float *) pVect1v;
+    const unsigned char *code = (const unsigned char *) pVect2v;
+    const PQParams *p = (const PQParams *) param_ptr;
+
+    float res = 0;
+    for (size_t m = 0; m < p->M; m++) res += lut[m * PQ_KSUB + code[m]];
+    return res;
+}
+
+static float
+PQSdc(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const unsigned char *a = (const unsigned char *) pVect1v;
+    const unsigned char *b = (const unsigned char *) pVect2v;
+    const PQParams *p = (const PQParams *) param_ptr;
+
+    float res = 0;
+    for (size_t m = 0; m < p->M; m++) res += p->sdc[(m * PQ_KSUB + a[m]) * PQ_KSUB + b[m]];
+    return res;
+}
+
+#if defined(USE_AVX2)
+
+HNSWLIB_TARGET_AVX2
+static float
+PQAdcAVX2(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const float *lut = (const float *) pVect1v;
+    const unsigned char *code = (const unsigned char *) pVect2v;
+    const PQParams *p = (const PQParams *) param_ptr;
+    size_t M8 = p->M >> 3 << 3;
+
+    // eight sub-quantizers per gather, lane i reads lut[(m + i) * PQ_KSUB + code[m + i]]
+    __m256i offs = _mm256_setr_epi32(0, 1 * PQ_KSUB, 2 * PQ_KSUB, 3 * PQ_KSUB,
+                                     4 * PQ_KSUB, 5 * PQ_KSUB, 6 * PQ_KSUB, 7 * PQ_KSUB);
+    const __m256i step = _mm256_set1_epi32(8 * PQ_KSUB);
+    __m256 sum = _mm256_setzero_ps();
+    for (size_t m = 0; m < M8; m += 8) {
+        __m256i c = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (code + m)));
+        sum = _mm256_add_ps(sum, _mm256_i32gather_ps(lut, _mm256_add_epi32(offs, c), 4));
+        offs = _mm256_add_epi32(offs, step);
+    }
+    float res = HorizontalSumAVX(sum);
+    for (size_t m = M8; m < p->M; m++) res += lut[m * PQ_KSUB + code[m]];
+    return res;
+}
+
+HNSWLIB_TARGET_AVX2
+static float
+PQSdcAVX2(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const unsigned char *a = (const unsigned char *) pVect1v;
+    const unsigned char *b = (const unsigned char *) pVect2v;
+    const PQParams *p = (const PQParams *) param_ptr;
+    size_t M8 = p->M >> 3 << 3;
+    const int table = PQ_KSUB * PQ_KSUB;
+
+    __m256i offs = _mm256_setr_epi32(0, 1 * table, 2 * table, 3 * table, 4 * table, 5 * table, 6 * table, 7 * table);
+    const __m256i step = _mm256_set1_epi32(8 * table);
+    __m256 sum = _mm256_setzero_ps();
+    for (size_t m = 0; m < M8; m += 8) {
+        __m256i ca = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (a + m)));
+        __m256i cb = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (b + m)));
+        __m256i idx = _mm256_add_epi32(offs, _mm256_add_epi32(_mm256_slli_epi32(ca, 8), cb));
+        sum = _mm256_add_ps(sum, _mm256_i32gather_ps(p->sdc, idx, 4));
+        offs = _mm256_add_epi32(offs, step);
+    }
+    float res = HorizontalSumAVX(sum);
+    for (size_t m = M8; m < p->M; m++) res += p->sdc[(m * PQ_KSUB + a[m]) * PQ_KSUB + b[m]];
+    return res;
+}
+
+#endif
+
+#if defined(USE_AVX512)
+
+HNSWLIB_TARGET_AVX512
+static float
+PQAdcAVX512(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const float *lut = (const float *) pVect1v;
+    const unsigned char *code = (const unsigned char *) pVect2v;
+    const PQParams *p = (const PQParams *) param_ptr;
+    size_t M16 = p->M >> 4 << 4;
+
+    __m512i offs = _mm512_mullo_epi32(
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(PQ_KSUB));
+    const __m512i step = _mm512_set1_epi32(16 * PQ_KSUB);
+    __m512 sum = _mm512_setzero_ps();
+    for (size_t m = 0; m < M16; m += 16) {
+        __m512i c = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *) (code + m)));
+        sum = _mm512_add_ps(sum, _mm512_i32gather_ps(_mm512_add_epi32(offs, c), lut, 4));
+        offs = _mm512_add_epi32(offs, step);
+    }
+    float res = _mm512_reduce_add_ps(sum);
+    for (size_t m = M16; m < p->M; m++) res += lut[m * PQ_KSUB + code[m]];
+    return res;
+}
+
+HNSWLIB_TARGET_AVX512
+static float
+PQSdcAVX512(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const unsigned char *a = (const unsigned char *) pVect1v;
+    const unsigned char *b = (const unsigned char *) pVect2v;
+    const PQParams *p = (const PQParams *) param_ptr;
+    size_t M16 = p->M >> 4 << 4;
+
+    __m512i offs = _mm512_mullo_epi32(
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(PQ_KSUB * PQ_KSUB));
+    const __m512i step = _mm512_set1_epi32(16 * PQ_KSUB * PQ_KSUB);
+    __m512 sum = _mm512_setzero_ps();
+    for (size_t m = 0; m < M16; m += 16) {
+        __m512i ca = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *) (a + m)));
+        __m512i cb = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *) (b + m)));
+        __m512i idx = _mm512_add_epi32(offs, _mm512_add_epi32(_mm512_slli_epi32(ca, 8), cb));
+        sum = _mm512_add_ps(sum, _mm512_i32gather_ps(idx, p->sdc, 4));
+        offs = _mm512_add_epi32(offs, step);
+    }
+    float res = _mm512_reduce_add_ps(sum);
+    for (size_t m = M16; m < p->M; m++) res += p->sdc[(m * PQ_KSUB + a[m]) * PQ_KSUB + b[m]];
+    return res;
+}
+
+#endif
+
+/*
+* L2 over product-quantized vectors. Train the codebooks with train() (or loadParams()) before building
+* or loading an index, and keep them next to it with saveParams().
+*
+* Queries go through prepareQuery(), which turns the float32 query into an M x 256 table of squared
+* distances to every centroid (get_query_size() bytes); searchKnn then takes that table as the query
+* and each distance is M table lookups. The graph itself is built with symmetric code to code
+* distances from a precomputed centroid distance table. Distances are approximate, rerank the top
+* candidates against the full vectors when exact order matters.
+*/
+class PQSpace : public QuantizedSpace {
+    DISTFUNC<float> fstdistfunc_;
+    DISTFUNC<float> fstquerydistfunc_;
+    const char *simd_level_ = "scalar";
+    size_t dsub_;
+    std::vector<float> centroids_;  // M x PQ_KSUB x dsub
+    std::vector<float> sdc_;
+    PQParams params_;
+
+    const float *centroid(size_t m, size_t k) const {
+        return centroids_.data() + (m * PQ_KSUB + k) * dsub_;
+    }
+
+    static float subL2(const float *a, const float *b, size_t n) {
+        float res = 0;
+        for (size_t i = 0; i < n; i++) {
+            float t = a[i] - b[i];
+            res += t * t;
+        }
+        return res;
+    }
+
+    size_t nearest(size_t m, const float *sub) const {
+        size_t best = 0;
+        float best_dist = std::numeric_limits<float>::max();
+        for (size_t k = 0; k < PQ_KSUB; k++) {
+            float d = subL2(sub, centroid(m, k), dsub_);
+            if (d < best_dist) {
+                best_dist = d;
+                best = k;
+            }
+        }
+        return best;
+    }
+
+    void updateTables() {
+        size_t M = params_.M;
+        sdc_.resize(M * PQ_KSUB * PQ_KSUB);
+        for (size_t m = 0; m < M; m++)
+            for (size_t i = 0; i < PQ_KSUB; i++)
+                for (size_t j = 0; j < PQ_KSUB; j++)
+                    sdc_[(m * PQ_KSUB + i) * PQ_KSUB + j] = subL2(centroid(m, i), centroid(m, j), dsub_);
+        params_.sdc = sdc_.data();
+    }
+
+ public:
+    PQSpace(size_t dim, size_t M) {
+        if (M == 0 || dim % M != 0)
+            throw std::runtime_error("PQ: dim " + std::to_string(dim) + " is not divisible by M=" + std::to_string(M));
+        params_.dim = dim;
+        params_.M = M;
+        dsub_ = dim / M;
+        centroids_.assign(M * PQ_KSUB * dsub_, 0.0f);
+        updateTables();
+
+        fstdistfunc_ = PQSdc;
+        fstquerydistfunc_ = PQAdc;
+#if defined(USE_AVX512)
+        if (AVX512Capable()) {
+            fstdistfunc_ = PQSdcAVX512;
+            fstquerydistfunc_ = PQAdcAVX512;
+            simd_level_ = "avx512";
+        } else
+#endif
+#if defined(USE_AVX2)
+        if (AVX2Capable()) {
+            fstdistfunc_ = PQSdcAVX2;
+            fstquerydistfunc_ = PQAdcAVX2;
+            simd_level_ = "avx2";
+        }
+#endif
+        ;
+    }
+
+    /*
+    * k-means with PQ_KSUB centroids in every sub-space over n row-major float32 vectors. Centroids
+    * start from distinct random samples; a cluster that runs empty is re-seeded by splitting the
+    * largest one. Needs at least PQ_KSUB vectors, 64 * PQ_KSUB or more give stable codebooks.
+    */
+    void train(const float *data, size_t n, size_t iterations = 20, unsigned seed = 1234) {
+        if (n < PQ_KSUB)
+            throw std::runtime_error("PQ: need at least " + std::to_string(PQ_KSUB) + " training vectors");
+        size_t dim = params_.dim;
+        std::mt19937 rng(seed);
+        std::vector<float> sub(n * dsub_);
+        std::vector<uint32_t> assign(n);
+        std::vector<size_t> counts(PQ_KSUB);
+        std::vector<size_t> perm(n);
+
+        for (size_t m = 0; m < params_.M; m++) {
+            for (size_t r = 0; r < n; r++)
+                memcpy(&sub[r * dsub_], data + r * dim + m * dsub_, dsub_ * sizeof(float));
+            float *cent = centroids_.data() + m * PQ_KSUB * dsub_;
+
+            std::iota(perm.begin(), perm.end(), 0);
+            for (size_t k = 0; k < PQ_KSUB; k++) {
+                std::swap(perm[k], perm[k + rng() % (n - k)]);
+                memcpy(cent + k * dsub_, &sub[perm[k] * dsub_], dsub_ * sizeof(float));
+            }
+
+            for (size_t it = 0; it < iterations; it++) {
+                for (size_t r = 0; r < n; r++) assign[r] = (uint32_t) nearest(m, &sub[r * dsub_]);
+
+                std::fill(cent, cent + PQ_KSUB * dsub_, 0.0f);
+                std::fill(counts.begin(), counts.end(), 0);
+                for (size_t r = 0; r < n; r++) {
+                    counts[assign[r]]++;
+                    float *c = cent + assign[r] * dsub_;
+                    for (size_t i = 0; i < dsub_; i++) c[i] += sub[r * dsub_ + i];
+                }
+                for (size_t k = 0; k < PQ_KSUB; k++) {
+                    if (counts[k] == 0) continue;
+                    for (size_t i = 0; i < dsub_; i++) cent[k * dsub_ + i] /= counts[k];
+                }
+                for (size_t k = 0; k < PQ_KSUB; k++) {
+                    if (counts[k] != 0) continue;
+                    size_t big = std::max_element(counts.begin(), counts.end()) - counts.begin();
+                    for (size_t i = 0; i < dsub_; i++) {
+                        float eps = (i % 2 ? 1 : -1) * 1.0f / 1024;
+                        cent[k * dsub_ + i] = cent[big * dsub_ + i] * (1 + eps);
+                        cent[big * dsub_ + i] *= 1 - eps;
+                    }
+                    counts[k] = counts[big] / 2;
+                    counts[big] -= counts[k];
+                }
+            }
+        }
+        updateTables();
+    }
+
+    void encode(const float *vec, void *code) const {
+        unsigned char *c = (unsigned char *) code;
+        for (size_t m = 0; m < params_.M; m++) c[m] = (unsigned char) nearest(m, vec + m * dsub_);
+    }
+
+    void decode(const void *code, float *vec) const {
+        const unsigned char *c = (const unsigned char *) code;
+        for (size_t m = 0; m < params_.M; m++)
+            memcpy(vec + m * dsub_, centroid(m, c[m]), dsub_ * sizeof(float));
+    }
+
+    size_t get_query_size() const {
+        return params_.M * PQ_KSUB * sizeof(float);
+    }
+
+    void prepareQuery(const float *query, void *out) const {
+        float *lut = (float *) out;
+        for (size_t m = 0; m < params_.M; m++)
+            for (size_t k = 0; k < PQ_KSUB; k++)
+                lut[m * PQ_KSUB + k] = subL2(query + m * dsub_, centroid(m, k), dsub_);
+    }
+
+    // File layout: size_t dim, size_t M, then M x 256 x (dim / M) floats of centroids
+    void saveParams(const std::string &location) const {
+        std::ofstream output(location, std::ios::binary);
+        writeBinaryPOD(output, params_.dim);
+        writeBinaryPOD(output, params_.M);
+        output.write((const char *) centroids_.data(), centroids_.size() * sizeof(float));
+        if (!output)
+            throw std::runtime_error("Failed to write PQ codebooks to " + location);
+    }
+
+    void loadParams(const std::string &location) {
+        std::ifstream input(location, std::ios::binary);
+        if (!input.is_open())
+            throw std::runtime_error("Cannot open file " + location);
+        size_t dim = 0, M = 0;
+        readBinaryPOD(input, dim);
+        readBinaryPOD(input, M);
+        if (dim != params_.dim || M != params_.M)
+            throw std::runtime_error("PQ codebooks are for dim " + std::to_string(dim) + ", M=" + std::to_string(M));
+        input.read((char *) centroids_.data(), centroids_.size() * sizeof(float));
+        if (!input)
+            throw std::runtime_error("PQ codebook file is truncated: " + location);
+        updateTables();
+    }
+
+    // Reads dim and M from a codebook file, for loading an index whose M is not known up front
+    static size_t readM(const std::string &location) {
+        std::ifstream input(location, std::ios::binary);
+        if (!input.is_open())
+            throw std::runtime_error("Cannot open file " + location);
+        size_t dim = 0, M = 0;
+        readBinaryPOD(input, dim);
+        readBinaryPOD(input, M);
+        return M;
+    }
+
+    size_t dim() const {
+        return params_.dim;
+    }
+
+    size_t subquantizers() const {
+        return params_.M;
+    }
+
+    size_t get_data_size() {
+        return params_.M;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    DISTFUNC<float> get_query_dist_func() {
+        return fstquerydistfunc_;
+    }
+
+    const char *get_simd_level() {
+        return simd_level_;
+    }
+
+    void *get_dist_func_param() {
+        return &params_;
+    }
+
+    ~PQSpace() {}
+};
+
+}  // namespace hnswlib
@@ -0,0 +1,570 @@
+#pragma once
+#include "hnswlib.h"
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace hnswlib {
+
+// Spaces whose elements are stored compressed. addPoint and saveIndex work on the codes produced by
+// encode(); searchKnn takes the query as produced by prepareQuery() and compares it against the codes
+// through get_query_dist_func(). For SQ8 and FP16 that is the plain float32 query, so search accuracy
+// only loses what the stored side was rounded by.
+class QuantizedSpace : public SpaceInterface<float> {
+ public:
+    virtual size_t dim() const = 0;
+
+    virtual void encode(const float *vec, void *code) const = 0;
+
+    virtual void decode(const void *code, float *vec) const = 0;
+
+    // Bytes written by prepareQuery()
+    virtual size_t get_query_size() const {
+        return dim() * sizeof(float);
+    }
+
+    virtual void prepareQuery(const float *query, void *out) const {
+        memcpy(out, query, get_query_size());
+    }
+};
+
+
+// ---------------------------------------------------------------------------------------------
+// SQ8: every dimension is scaled from [min, max] to 0..255 independently
+// ---------------------------------------------------------------------------------------------
+
+// dim has to stay the first member, hnswlib reads the dimension through *(size_t *) dist_func_param
+struct SQ8Params {
+    size_t dim;
+    const float *vmin;    // per-dimension minimum
+    const float *scale;   // per-dimension (max - min) / 255
+    const float *scale2;  // scale squared, for code vs code distances
+};
+
+static float
+SQ8L2SqrQuery(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const float *q = (const float *) pVect1v;
+    const unsigned char *c = (const unsigned char *) pVect2v;
+    const SQ8Params *p = (const SQ8Params *) param_ptr;
+
+    float res = 0;
+    for (size_t i = 0; i < p->dim; i++) {
+        float t = q[i] - (p->vmin[i] + c[i] * p->scale[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+static float
+SQ8L2SqrCodes(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const unsigned char *a = (const unsigned char *) pVect1v;
+    const unsigned char *b = (const unsigned char *) pVect2v;
+    const SQ8Params *p = (const SQ8Params *) param_ptr;
+
+    float res = 0;
+    for (size_t i = 0; i < p->dim; i++) {
+        float t = (float) a[i] - (float) b[i];
+        res += t * t * p->scale2[i];
+    }
+    return res;
+}
+
+#if defined(USE_AVX2)
+
+HNSWLIB_TARGET_AVX2
+static inline float
+HorizontalSumAVX(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+HNSWLIB_TARGET_AVX2
+static float
+SQ8L2SqrQueryAVX2(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const float *q = (const float *) pVect1v;
+    const unsigned char *c = (const unsigned char *) pVect2v;
+    const SQ8Params *p = (const SQ8Params *) param_ptr;
+    size_t dim8 = p->dim >> 3 << 3;
+
+    __m256 sum = _mm256_setzero_ps();
+    for (size_t i = 0; i < dim8; i += 8) {
+        __m128i bytes = _mm_loadl_epi64((const __m128i *) (c + i));
+        __m256 cf = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+        __m256 x = _mm256_fmadd_ps(cf, _mm256_loadu_ps(p->scale + i), _mm256_loadu_ps(p->vmin + i));
+        __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(q + i), x);
+        sum = _mm256_fmadd_ps(diff, diff, sum);
+    }
+    float res = HorizontalSumAVX(sum);
+    for (size_t i = dim8; i < p->dim; i++) {
+        float t = q[i] - (p->vmin[i] + c[i] * p->scale[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+HNSWLIB_TARGET_AVX2
+static float
+SQ8L2SqrCodesAVX2(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const unsigned char *a = (const unsigned char *) pVect1v;
+    const unsigned char *b = (const unsigned char *) pVect2v;
+    const SQ8Params *p = (const SQ8Params *) param_ptr;
+    size_t dim8 = p->dim >> 3 << 3;
+
+    __m256 sum = _mm256_setzero_ps();
+    for (size_t i = 0; i < dim8; i += 8) {
+        __m256i va = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (a + i)));
+        __m256i vb = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (b + i)));
+        __m256 diff = _mm256_cvtepi32_ps(_mm256_sub_epi32(va, vb));
+        sum = _mm256_fmadd_ps(_mm256_mul_ps(diff, diff), _mm256_loadu_ps(p->scale2 + i), sum);
+    }
+    float res = HorizontalSumAVX(sum);
+    for (size_t i = dim8; i < p->dim; i++) {
+        float t = (float) a[i] - (float) b[i];
+        res += t * t * p->scale2[i];
+    }
+    return res;
+}
+
+#endif
+
+#if defined(USE_AVX512)
+
+HNSWLIB_TARGET_AVX512
+static float
+SQ8L2SqrQueryAVX512(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const float *q = (const float *) pVect1v;
+    const unsigned char *c = (const unsigned char *) pVect2v;
+    const SQ8Params *p = (const SQ8Params *) param_ptr;
+    size_t dim16 = p->dim >> 4 << 4;
+
+    __m512 sum = _mm512_setzero_ps();
+    for (size_t i = 0; i < dim16; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *) (c + i));
+        __m512 cf = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(bytes));
+        __m512 x = _mm512_fmadd_ps(cf, _mm512_loadu_ps(p->scale + i), _mm512_loadu_ps(p->vmin + i));
+        __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(q + i), x);
+        sum = _mm512_fmadd_ps(diff, diff, sum);
+    }
+    float res = _mm512_reduce_add_ps(sum);
+    for (size_t i = dim16; i < p->dim; i++) {
+        float t = q[i] - (p->vmin[i] + c[i] * p->scale[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+HNSWLIB_TARGET_AVX512
+static float
+SQ8L2SqrCodesAVX512(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const unsigned char *a = (const unsigned char *) pVect1v;
+    const unsigned char *b = (const unsigned char *) pVect2v;
+    const SQ8Params *p = (const SQ8Params *) param_ptr;
+    size_t dim16 = p->dim >> 4 << 4;
+
+    __m512 sum = _mm512_setzero_ps();
+    for (size_t i = 0; i < dim16; i += 16) {
+        __m512i va = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *) (a + i)));
+        __m512i vb = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *) (b + i)));
+        __m512 diff = _mm512_cvtepi32_ps(_mm512_sub_epi32(va, vb));
+        sum = _mm512_fmadd_ps(_mm512_mul_ps(diff, diff), _mm512_loadu_ps(p->scale2 + i), sum);
+    }
+    float res = _mm512_reduce_add_ps(sum);
+    for (size_t i = dim16; i < p->dim; i++) {
+        float t = (float) a[i] - (float) b[i];
+        res += t * t * p->scale2[i];
+    }
+    return res;
+}
+
+#endif
+
+/*
+* L2 over vectors stored as one byte per dimension. Call train() (or loadParams()) before building or
+* loading an index; the min/max ranges are not part of the hnswlib index file, keep them next to it
+* with saveParams(). Values outside the trained range are clamped when encoding.
+*/
+class SQ8Space : public QuantizedSpace {
+    DISTFUNC<float> fstdistfunc_;
+    DISTFUNC<float> fstquerydistfunc_;
+    const char *simd_level_ = "scalar";
+    std::vector<float> vmin_, scale_, scale2_;
+    SQ8Params params_;
+
+    void updateParams() {
+        scale2_.resize(params_.dim);
+        for (size_t i = 0; i < params_.dim; i++) scale2_[i] = scale_[i] * scale_[i];
+        params_.vmin = vmin_.data();
+        params_.scale = scale_.data();
+        params_.scale2 = scale2_.data();
+    }
+
+ public:
+    SQ8Space(size_t dim) : vmin_(dim, 0.0f), scale_(dim, 1.0f / 255) {
+        params_.dim = dim;
+        updateParams();
+
+        fstdistfunc_ = SQ8L2SqrCodes;
+        fstquerydistfunc_ = SQ8L2SqrQuery;
+#if defined(USE_AVX512)
+        if (AVX512Capable()) {
+            fstdistfunc_ = SQ8L2SqrCodesAVX512;
+            fstquerydistfunc_ = SQ8L2SqrQueryAVX512;
+            simd_level_ = "avx512";
+        } else
+#endif
+#if defined(USE_AVX2)
+        if (AVX2Capable()) {
+            fstdistfunc_ = SQ8L2SqrCodesAVX2;
+            fstquerydistfunc_ = SQ8L2SqrQueryAVX2;
+            simd_level_ = "avx2";
+        }
+#endif
+        ;
+    }
+
+    // Per-dimension min/max over n row-major float32 vectors
+    void train(const float *data, size_t n) {
+        size_t dim = params_.dim;
+        std::vector<float> vmax(dim, std::numeric_limits<float>::lowest());
+        std::fill(vmin_.begin(), vmin_.end(), std::numeric_limits<float>::max());
+        for (size_t r = 0; r < n; r++) {
+            const float *v = data + r * dim;
+            for (size_t i = 0; i < dim; i++) {
+                vmin_[i] = std::min(vmin_[i], v[i]);
+                vmax[i] = std::max(vmax[i], v[i]);
+            }
+        }
+        for (size_t i = 0; i < dim; i++) {
+            if (n == 0) {
+                vmin_[i] = 0;
+                vmax[i] = 0;
+            }
+            float range = vmax[i] - vmin_[i];
+            scale_[i] = range > 0 ? range / 255.0f : 1.0f / 255;
+        }
+        updateParams();
+    }
+
+    void encode(const float *vec, void *code) const {
+        unsigned char *c = (unsigned char *) code;
+        for (size_t i = 0; i < params_.dim; i++) {
+            float x = (vec[i] - vmin_[i]) / scale_[i];
+            x = std::min(255.0f, std::max(0.0f, x));
+            c[i] = (unsigned char) (x + 0.5f);
+        }
+    }
+
+    void decode(const void *code, float *vec) const {
+        const unsigned char *c = (const unsigned char *) code;
+        for (size_t i = 0; i < params_.dim; i++) vec[i] = vmin_[i] + c[i] * scale_[i];
+    }
+
+    // File layout: size_t dim, then dim floats of min and dim floats of scale
+    void saveParams(const std::string &location) const {
+        std::ofstream output(location, std::ios::binary);
+        writeBinaryPOD(output, params_.dim);
+        output.write((const char *) vmin_.data(), params_.dim * sizeof(float));
+        output.write((const char *) scale_.data(), params_.dim * sizeof(float));
+        if (!output)
+            throw std::runtime_error("Failed to write SQ8 parameters to " + location);
+    }
+
+    void loadParams(const std::string &location) {
+        std::ifstream input(location, std::ios::binary);
+        if (!input.is_open())
+            throw std::runtime_error("Cannot open file " + location);
+        size_t dim = 0;
+        readBinaryPOD(input, dim);
+        if (dim != params_.dim)
+            throw std::runtime_error("SQ8 parameters are for dim " + std::to_string(dim));
+        input.read((char *) vmin_.data(), dim * sizeof(float));
+        input.read((char *) scale_.data(), dim * sizeof(float));
+        if (!input)
+            throw std::runtime_error("SQ8 parameter file is truncated: " + location);
+        updateParams();
+    }
+
+    size_t dim() const {
+        return params_.dim;
+    }
+
+    size_t get_data_size() {
+        return params_.dim;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    DISTFUNC<float> get_query_dist_func() {
+        return fstquerydistfunc_;
+    }
+
+    const char *get_simd_level() {
+        return simd_level_;
+    }
+
+    void *get_dist_func_param() {
+        return &params_;
+    }
+
+    ~SQ8Space() {}
+};
+
+
+// ---------------------------------------------------------------------------------------------
+// FP16: IEEE 754 half precision storage
+// ---------------------------------------------------------------------------------------------
+
+// Round to nearest even, overflow goes to infinity
+static inline uint16_t
+FloatToHalf(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint16_t sign = (x >> 16) & 0x8000;
+    uint32_t absx = x & 0x7fffffff;
+    if (absx > 0x7f800000) return sign | 0x7e00;  // NaN
+    int32_t exp = (int32_t) (absx >> 23) - 127 + 15;
+    uint32_t mant = absx & 0x7fffff;
+    if (exp >= 31) return sign | 0x7c00;
+    if (exp <= 0) {
+        if (exp < -10) return sign;
+        mant |= 0x800000;
+        uint32_t shift = 14 - exp;
+        uint32_t half_mant = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (half_mant & 1))) half_mant++;
+        return sign | half_mant;
+    }
+    uint16_t h = sign | (exp << 10) | (mant >> 13);
+    uint32_t rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;  // a carry into the exponent is still correct
+    return h;
+}
+
+static inline float
+HalfToFloat(uint16_t h) {
+    uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+    int32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t x;
+    if (exp == 0) {
+        if (mant == 0) {
+            x = sign;
+        } else {
+            exp = 1;
+            while (!(mant & 0x400)) {
+                mant <<= 1;
+                exp--;
+            }
+            mant &= 0x3ff;
+            x = sign | ((uint32_t) (exp + 112) << 23) | (mant << 13);
+        }
+    } else if (exp == 31) {
+        x = sign | 0x7f800000 | (mant << 13);
+    } else {
+        x = sign | ((uint32_t) (exp + 112) << 23) | (mant << 13);
+    }
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+static float
+FP16L2SqrQuery(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const float *q = (const float *) pVect1v;
+    const uint16_t *h = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    float res = 0;
+    for (size_t i = 0; i < qty; i++) {
+        float t = q[i] - HalfToFloat(h[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+static float
+FP16L2SqrCodes(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *a = (const uint16_t *) pVect1v;
+    const uint16_t *b = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    float res = 0;
+    for (size_t i = 0; i < qty; i++) {
+        float t = HalfToFloat(a[i]) - HalfToFloat(b[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+#if defined(USE_AVX2)
+
+HNSWLIB_TARGET_AVX2
+static float
+FP16L2SqrQueryAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const float *q = (const float *) pVect1v;
+    const uint16_t *h = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty8 = qty >> 3 << 3;
+
+    __m256 sum = _mm256_setzero_ps();
+    for (size_t i = 0; i < qty8; i += 8) {
+        __m256 x = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (h + i)));
+        __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(q + i), x);
+        sum = _mm256_fmadd_ps(diff, diff, sum);
+    }
+    float res = HorizontalSumAVX(sum);
+    for (size_t i = qty8; i < qty; i++) {
+        float t = q[i] - HalfToFloat(h[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+HNSWLIB_TARGET_AVX2
+static float
+FP16L2SqrCodesAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *a = (const uint16_t *) pVect1v;
+    const uint16_t *b = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty8 = qty >> 3 << 3;
+
+    __m256 sum = _mm256_setzero_ps();
+    for (size_t i = 0; i < qty8; i += 8) {
+        __m256 va = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (a + i)));
+        __m256 vb = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (b + i)));
+        __m256 diff = _mm256_sub_ps(va, vb);
+        sum = _mm256_fmadd_ps(diff, diff, sum);
+    }
+    float res = HorizontalSumAVX(sum);
+    for (size_t i = qty8; i < qty; i++) {
+        float t = HalfToFloat(a[i]) - HalfToFloat(b[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+#endif
+
+#if defined(USE_AVX512)
+
+HNSWLIB_TARGET_AVX512
+static float
+FP16L2SqrQueryAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const float *q = (const float *) pVect1v;
+    const uint16_t *h = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty16 = qty >> 4 << 4;
+
+    __m512 sum = _mm512_setzero_ps();
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m512 x = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *) (h + i)));
+        __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(q + i), x);
+        sum = _mm512_fmadd_ps(diff, diff, sum);
+    }
+    float res = _mm512_reduce_add_ps(sum);
+    for (size_t i = qty16; i < qty; i++) {
+        float t = q[i] - HalfToFloat(h[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+HNSWLIB_TARGET_AVX512
+static float
+FP16L2SqrCodesAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *a = (const uint16_t *) pVect1v;
+    const uint16_t *b = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty16 = qty >> 4 << 4;
+
+    __m512 sum = _mm512_setzero_ps();
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m512 va = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *) (a + i)));
+        __m512 vb = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *) (b + i)));
+        __m512 diff = _mm512_sub_ps(va, vb);
+        sum = _mm512_fmadd_ps(diff, diff, sum);
+    }
+    float res = _mm512_reduce_add_ps(sum);
+    for (size_t i = qty16; i < qty; i++) {
+        float t = HalfToFloat(a[i]) - HalfToFloat(b[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+#endif
+
+// L2 over vectors stored as half floats. Needs no training.
+class FP16Space : public QuantizedSpace {
+    DISTFUNC<float> fstdistfunc_;
+    DISTFUNC<float> fstquerydistfunc_;
+    const char *simd_level_ = "scalar";
+    size_t dim_;
+
+ public:
+    FP16Space(size_t dim) : dim_(dim) {
+        fstdistfunc_ = FP16L2SqrCodes;
+        fstquerydistfunc_ = FP16L2SqrQuery;
+#if defined(USE_AVX512)
+        if (AVX512Capable()) {
+            fstdistfunc_ = FP16L2SqrCodesAVX512;
+            fstquerydistfunc_ = FP16L2SqrQueryAVX512;
+            simd_level_ = "avx512";
+        } else
+#endif
+#if defined(USE_AVX2)
+        if (AVX2Capable()) {
+            fstdistfunc_ = FP16L2SqrCodesAVX2;
+            fstquerydistfunc_ = FP16L2SqrQueryAVX2;
+            simd_level_ = "avx2";
+        }
+#endif
+        ;
+    }
+
+    void encode(const float *vec, void *code) const {
+        uint16_t *h = (uint16_t *) code;
+        for (size_t i = 0; i < dim_; i++) h[i] = FloatToHalf(vec[i]);
+    }
+
+    void decode(const void *code, float *vec) const {
+        const uint16_t *h = (const uint16_t *) code;
+        for (size_t i = 0; i < dim_; i++) vec[i] = HalfToFloat(h[i]);
+    }
+
+    size_t dim() const {
+        return dim_;
+    }
+
+    size_t get_data_size() {
+        return dim_ * sizeof(uint16_t);
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    DISTFUNC<float> get_query_dist_func() {
+        return fstquerydistfunc_;
+    }
+
+    const char *get_simd_level() {
+        return simd_level_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    ~FP16Space() {}
+};
+
+}  // namespace hnswlib
@@ -273,4 +273,79 @@ class EpsilonSearchStopCondition : public BaseSearchStopCondition<dist_t> {
 
     ~EpsilonSearchStopCondition() {}
 };
+
+
+// Range search where min_num_candidates plays the role of ef.
+// EpsilonSearchStopCondition counts every point added to the result towards
+// min_num_candidates, and a single expansion adds up to maxM0 points, so the search
+// often stops after a few hops with points inside epsilon still unvisited.
+// Here the min_num_candidates closest points found so far are tracked separately:
+// the search goes on while the next candidate is inside epsilon or could still improve
+// them, exactly like an ef search that never drops points inside epsilon.
+template<typename dist_t>
+class RangeSearchStopCondition : public BaseSearchStopCondition<dist_t> {
+    dist_t epsilon_;
+    size_t min_num_candidates_;
+    size_t max_num_candidates_;
+    size_t curr_num_items_;
+    std::priority_queue<dist_t> closest_;  // the min_num_candidates smallest distances seen
+
+    dist_t closest_bound() const {
+        return closest_.size() < min_num_candidates_ ? std::numeric_limits<dist_t>::max() : closest_.top();
+    }
+
+ public:
+    RangeSearchStopCondition(dist_t epsilon, size_t min_num_candidates, size_t max_num_candidates) {
+        assert(min_num_candidates >= 1 && min_num_candidates <= max_num_candidates);
+        epsilon_ = epsilon;
+        min_num_candidates_ = min_num_candidates;
+        max_num_candidates_ = max_num_candidates;
+        curr_num_items_ = 0;
+    }
+
+    void add_point_to_result(labeltype label, const void *datapoint, dist_t dist) override {
+        curr_num_items_ += 1;
+        if (closest_.size() < min_num_candidates_) {
+            closest_.push(dist);
+        } else if (dist < closest_.top()) {
+            closest_.pop();
+            closest_.push(dist);
+        }
+    }
+
+    // only the farthest point is ever removed, and only when there are more than
+    // max_num_candidates >= min_num_candidates of them, so closest_ is unaffected
+    void remove_point_from_result(labeltype label, const void *datapoint, dist_t dist) override {
+        curr_num_items_ -= 1;
+    }
+
+    bool should_stop_search(dist_t candidate_dist, dist_t lowerBound) override {
+        if (candidate_dist > lowerBound && curr_num_items_ == max_num_candidates_) {
+            return true;
+        }
+        return candidate_dist > epsilon_ && candidate_dist > closest_bound();
+    }
+
+    bool should_consider_candidate(dist_t candidate_dist, dist_t lowerBound) override {
+        if (candidate_dist > epsilon_ && candidate_dist >= closest_bound()) {
+            return false;
+        }
+        return curr_num_items_ < max_num_candidates_ || lowerBound > candidate_dist;
+    }
+
+    bool should_remove_extra() override {
+        return curr_num_items_ > max_num_candidates_;
+    }
+
+    void filter_results(std::vector<std::pair<dist_t, labeltype >> &candidates) override {
+        while (!candidates.empty() && candidates.back().first > epsilon_) {
+            candidates.pop_back();
+        }
+        while (candidates.size() > max_num_candidates_) {
+            candidates.pop_back();
+        }
+    }
+
+    ~RangeSearchStopCondition() {}
+};
 }  // namespace hnswlib
\ No newline at end of file
@@ -3,7 +3,16 @@
 #include <random>
 #include <fstream>
 #include <string>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <thread>
 #include <rocksdb/db.h>
+#include "bulk_loader.h"
+#include "parallel_for.h"
+#include "partitioned_build.h"
+#include "vector_reader.h"
 #include "../tools/common.h"
 #include "../hnswlib/hnswlib.h"
 
@@ -38,7 +47,8 @@ void export_adjacency(hnswlib::HierarchicalNSW<float>& appr_alg, const std::stri
     std::ofstream out(outpath, std::ios::binary);
     if (!out) throw std::runtime_error("Cannot open adjacency output file");
 
-    uint32_t entry_u = static_cast<uint32_t>(enterpoint < 0 ? 0 : enterpoint);
+    // 并行建图时内部 id 与 label 不再一一对应，入口点和邻居都写成 label
+    uint32_t entry_u = enterpoint < 0 ? 0 : static_cast<uint32_t>(appr_alg.getExternalLabel(static_cast<tableint>(enterpoint)));
     uint32_t maxlevel_u = static_cast<uint32_t>(maxlevel < 0 ? 0 : maxlevel);
     uint32_t node_count_u = static_cast<uint32_t>(cur_elements);
 
@@ -94,8 +104,8 @@ void export_adjacency(hnswlib::HierarchicalNSW<float>& appr_alg, const std::stri
                     unsigned int nb_label = 0; // invalid -> write 0
                     out.write(reinterpret_cast<const char*>(&nb_label), sizeof(nb_label));
                 } else {
-                    uint32_t nb_internal_idx = static_cast<uint32_t>(nb_internal);
-                    out.write(reinterpret_cast<const char*>(&nb_internal_idx), sizeof(nb_internal_idx));
+                    uint32_t nb_label = static_cast<uint32_t>(appr_alg.getExternalLabel(nb_internal));
+                    out.write(reinterpret_cast<const char*>(&nb_label), sizeof(nb_label));
                 }
             }
         }
@@ -114,37 +124,280 @@ int main(int argc, char** argv) {
     int ef_construction = 200;
     std::string dbpath = "./rocksdb_data";
     std::string graph_out = "./hnsw_graph.bin";
-    if (argc>1) N = std::stoul(argv[1]);
-    if (argc>2) dim = std::stoul(argv[2]);
-    if (argc>3) dbpath = argv[3];
-    if (argc>4) graph_out = argv[4];
-    if (argc>5) M = std::stoi(argv[5]);
-    if (argc>6) ef_construction = std::stoi(argv[6]);
+    bool page_aligned = false; // --page-aligned：按页对齐布局保存，hnsw_service 可用 --mmap 1 直接映射
+    std::string quant;         // --quant sq8|fp16|pq：图中的向量按 SQ8/FP16/PQ 压缩存储，RocksDB 中仍为 float32
+    size_t pq_m = 0;           // --pq-m：PQ 子空间个数（每条向量的字节数），须整除 dim，默认 dim/8
+    size_t num_threads = 1;    // --threads：并行插入的线程数，0 表示使用全部核
+    std::string db_load = "sst"; // --db-load sst|batch：向量写入 RocksDB 的方式，见 bulk_loader.h
+    size_t sst_mb = 256;       // --sst-mb：sst 模式下每批缓冲的向量大小（MB），也是单次导入的数据量
+    std::string input;         // --input：从数据集文件流式读取向量，不指定时生成正态分布随机向量
+    std::string input_format;  // --format fvecs|bvecs|npy|raw：默认按扩展名判断，raw 的维度取位置参数 dim
+    size_t partitions = 1;     // --partitions：大于 1 时分区建图再合并，内存只需容纳一个分区，见 partitioned_build.h
+    size_t overlap = 2;        // --overlap：分区建图时每条向量分到最近的几个分区
+    size_t shard_id = 0;       // --shard-id/--shards：只建 N 条中的第 shard_id 段（共 shards 段），
+    size_t shards = 1;         //   label 仍为全局 id，供 hnsw_service --shards 路由模式使用
+    std::string doc_ids_path;  // --doc-ids：每条向量所属的文档 id（uint32 数组，见 DocIdReader），
+                               //   建多向量索引，供 hnsw_service --multi-vector 1 的 /search_docs 使用
+
+    // 位置参数：N dim dbpath graph_out M ef_construction，"--" 开头的为可选开关
+    std::vector<std::string> pos;
+    for (int i=1;i<argc;i++){
+        std::string a = argv[i];
+        if (a=="--page-aligned") page_aligned = true;
+        else if (a=="--quant" && i+1<argc) quant = argv[++i];
+        else if (a=="--pq-m" && i+1<argc) pq_m = std::stoul(argv[++i]);
+        else if (a=="--threads" && i+1<argc) num_threads = std::stoul(argv[++i]);
+        else if (a=="--db-load" && i+1<argc) db_load = argv[++i];
+        else if (a=="--sst-mb" && i+1<argc) sst_mb = std::stoul(argv[++i]);
+        else if (a=="--input" && i+1<argc) input = argv[++i];
+        else if (a=="--format" && i+1<argc) input_format = argv[++i];
+        else if (a=="--partitions" && i+1<argc) partitions = std::stoul(argv[++i]);
+        else if (a=="--overlap" && i+1<argc) overlap = std::stoul(argv[++i]);
+        else if (a=="--shard-id" && i+1<argc) shard_id = std::stoul(argv[++i]);
+        else if (a=="--shards" && i+1<argc) shards = std::stoul(argv[++i]);
+        else if (a=="--doc-ids" && i+1<argc) doc_ids_path = argv[++i];
+        else pos.push_back(a);
+    }
+    if (pos.size()>0) N = std::stoul(pos[0]);
+    if (pos.size()>1) dim = std::stoul(pos[1]);
+    if (pos.size()>2) dbpath = pos[2];
+    if (pos.size()>3) graph_out = pos[3];
+    if (pos.size()>4) M = std::stoi(pos[4]);
+    if (pos.size()>5) ef_construction = std::stoi(pos[5]);
+    if (num_threads == 0) num_threads = std::max<unsigned>(std::thread::hardware_concurrency(), 1);
+    if (db_load != "sst" && db_load != "batch") {
+        std::cerr << "unknown --db-load " << db_load << ", expected sst or batch\n";
+        return 1;
+    }
+    if (shards == 0 || shard_id >= shards) {
+        std::cerr << "--shard-id must be less than --shards\n";
+        return 1;
+    }
+    if (partitions > 1 && (!quant.empty() || page_aligned)) {
+        std::cerr << "--partitions does not support --quant or --page-aligned\n";
+        return 1;
+    }
+    if (!doc_ids_path.empty() && (partitions > 1 || !quant.empty())) {
+        std::cerr << "--doc-ids does not support --partitions or --quant\n";
+        return 1;
+    }
 
     std::mt19937_64 rng(123);
     std::normal_distribution<float> nd(0.0f,1.0f);
 
+    // 有 --input 时维度取自文件，N 为 0 或超过文件中的条数时取全部
+    std::unique_ptr<VectorReader> reader;
+    if (!input.empty()) {
+        try {
+            reader = std::make_unique<VectorReader>(input, input_format, dim);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        dim = reader->dim();
+        if (N == 0 || N > reader->count()) N = reader->count();
+        std::cerr << "input " << input << " (" << reader->format() << "): " << reader->count()
+                  << " vectors, dim " << dim << ", using " << N << "\n";
+    }
+    // 分片时 N 变为本分片的条数，第 i 条的 label 为 first_id + i。随机数据也按全局顺序生成后跳过前面的，
+    // 各分片合起来与不分片时是同一份数据
+    size_t first_id = 0;
+    if (shards > 1) {
+        first_id = shard_id * N / shards;
+        N = (shard_id + 1) * N / shards - first_id;
+        std::cerr << "shard " << shard_id << "/" << shards << ": ids [" << first_id << ", " << first_id + N << ")\n";
+    }
+    auto skip_to_shard = [&](VectorReader* r) {
+        if (r) {
+            r->skip(first_id);
+            return;
+        }
+        for (size_t j = 0; j < first_id * dim; j++) nd(rng);
+    };
+    // 文档 id 与向量一一对应，须覆盖用到的全部向量
+    std::unique_ptr<DocIdReader> doc_ids;
+    if (!doc_ids_path.empty()) {
+        try {
+            doc_ids = std::make_unique<DocIdReader>(doc_ids_path);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        if (doc_ids->count() < first_id + N) {
+            std::cerr << doc_ids_path << ": " << doc_ids->count() << " doc ids, need " << first_id + N << "\n";
+            return 1;
+        }
+        doc_ids->skip(first_id);
+    }
+    // 按顺序取本分片接下来的 n 条向量，返回实际取到的条数
+    bool skipped = false;
+    auto next_vectors = [&](float* out, size_t n) -> size_t {
+        if (!skipped) {
+            skip_to_shard(reader.get());
+            skipped = true;
+        }
+        if (reader) return reader->read(out, n);
+        for (size_t j = 0; j < n * dim; j++) out[j] = nd(rng);
+        return n;
+    };
+
     rocksdb::Options options;
     options.create_if_missing=true;
+    BulkLoader::tune_options(options, num_threads);
     rocksdb::DB* db;
     rocksdb::Status s = rocksdb::DB::Open(options, dbpath, &db);
     if (!s.ok()) { std::cerr<<"RocksDB open error: "<<s.ToString()<<"\n"; return 1; }
 
-    hnswlib::L2Space l2space((int)dim);
-    hnswlib::HierarchicalNSW<float> appr_alg(&l2space, N, M, ef_construction);
-
-    std::vector<float> v(dim);
-    for (size_t i=0;i<N;i++){
-        for (size_t d=0; d<dim; d++) v[d] = nd(rng);
-        uint32_t id = (uint32_t)i;
-        std::string key(reinterpret_cast<const char*>(&id), sizeof(id));
-        std::string val = vec_to_bytes(std::vector<float>(v.begin(), v.end()));
-        db->Put(rocksdb::WriteOptions(), key, val);
-        appr_alg.addPoint((void*)v.data(), id);
-        if ((i+1)%10000==0) std::cerr<<"added "<<(i+1)<<" points\n";
+    // 临时 SST 文件放在数据库目录旁边，保证与数据库在同一文件系统上
+    std::string sst_dir = dbpath;
+    while (sst_dir.size() > 1 && sst_dir.back() == '/') sst_dir.pop_back();
+    sst_dir += ".bulk_sst";
+    BulkLoader loader(db, options, db_load == "sst" ? BulkLoader::Mode::Sst : BulkLoader::Mode::Batch, dim,
+                      sst_dir, num_threads, (sst_mb << 20) / (dim * sizeof(float)));
+
+    std::unique_ptr<hnswlib::SpaceInterface<float>> space;
+    hnswlib::QuantizedSpace* qspace = nullptr;
+    hnswlib::BaseMultiVectorSpace<uint32_t>* mvspace = nullptr;  // 有 --doc-ids 时每个元素是向量 + 文档 id
+    // SQ8/PQ 需要先训练：取本分片前 n_train 条向量训练。数据集文件另开一个 reader 读开头部分，
+    // 随机数据则在训练后重置随机数，重新生成同一批数据建图
+    auto training_sample = [&](size_t n_train) {
+        std::vector<float> train(n_train * dim);
+        if (reader) {
+            VectorReader sample(input, input_format, dim);
+            skip_to_shard(&sample);
+            sample.read(train.data(), n_train);
+            return train;
+        }
+        skip_to_shard(nullptr);
+        for (auto& x : train) x = nd(rng);
+        rng.seed(123);
+        nd.reset();
+        return train;
+    };
+    if (partitions > 1) {
+        PartitionedBuildConfig cfg;
+        cfg.N = N;
+        cfg.dim = dim;
+        cfg.M = M;
+        cfg.ef_construction = ef_construction;
+        cfg.partitions = partitions;
+        cfg.overlap = overlap;
+        cfg.num_threads = num_threads;
+        cfg.chunk = std::max<size_t>(10000, num_threads * 1000);
+        cfg.graph_out = graph_out;
+        cfg.first_label = first_id;
+        bool ok = build_partitioned(cfg, training_sample(std::min(N, (size_t)100000)), next_vectors, loader);
+        if (ok) loader.finish();
+        delete db;
+        return ok ? 0 : 1;
+    }
+    if (doc_ids) {
+        auto mv = std::make_unique<hnswlib::MultiVectorL2Space<uint32_t>>(dim);
+        mvspace = mv.get();
+        space = std::move(mv);
+    } else if (quant.empty()) {
+        space = std::make_unique<hnswlib::L2Space>(dim);
+    } else if (quant=="sq8") {
+        auto sq8 = std::make_unique<hnswlib::SQ8Space>(dim);
+        size_t n_train = std::min(N, (size_t)100000);
+        sq8->train(training_sample(n_train).data(), n_train);
+        sq8->saveParams(graph_out + ".sq8");
+        qspace = sq8.get();
+        space = std::move(sq8);
+    } else if (quant=="fp16") {
+        auto fp16 = std::make_unique<hnswlib::FP16Space>(dim);
+        qspace = fp16.get();
+        space = std::move(fp16);
+    } else if (quant=="pq") {
+        // 每个子空间 256 个质心，每个质心约 256 个训练样本就够了
+        if (pq_m == 0) pq_m = std::max<size_t>(dim / 8, 1);
+        auto pq = std::make_unique<hnswlib::PQSpace>(dim, pq_m);
+        size_t n_train = std::min(N, hnswlib::PQ_KSUB * 256);
+        std::cerr << "training PQ codebooks: M=" << pq_m << " on " << n_train << " vectors\n";
+        pq->train(training_sample(n_train).data(), n_train);
+        pq->saveParams(graph_out + ".pq");
+        qspace = pq.get();
+        space = std::move(pq);
+    } else {
+        std::cerr << "unknown --quant " << quant << ", expected sq8, fp16 or pq\n";
+        return 1;
+    }
+    hnswlib::HierarchicalNSW<float> appr_alg(space.get(), N, M, ef_construction);
+
+    // 按块流水线处理：第 k 块由 num_threads 个线程并行插入图中，同时另起线程把它写入 RocksDB、
+    // 读入（或生成）第 k+1 块。内存中只有两块，与数据集大小无关；数据按固定顺序读取，与线程数无关。
+    // 块要足够大，块末尾等最慢线程的时间才可以忽略
+    size_t chunk = std::max<size_t>(10000, num_threads * 1000);
+    size_t code_size = space->get_data_size();
+    struct Chunk {
+        std::vector<float> vecs;
+        std::vector<uint32_t> docs;
+        size_t begin = 0;
+        size_t n = 0;
+    };
+    Chunk cur, next;
+    cur.vecs.resize(chunk * dim);
+    next.vecs.resize(chunk * dim);
+    if (doc_ids) {
+        cur.docs.resize(chunk);
+        next.docs.resize(chunk);
+    }
+    std::vector<char> codes(qspace || mvspace ? chunk * code_size : 0);
+    auto fill = [&](Chunk& c, size_t begin) {
+        c.begin = begin;
+        c.n = begin < N ? next_vectors(c.vecs.data(), std::min(chunk, N - begin)) : 0;
+        if (doc_ids && doc_ids->read(c.docs.data(), c.n) != c.n) throw std::runtime_error(doc_ids_path + ": short read");
+    };
+    std::cerr << "building " << N << " points with " << num_threads << " threads\n";
+
+    auto t_start = std::chrono::steady_clock::now();
+    size_t done = 0;
+    try {
+        fill(cur, 0);
+        while (cur.n > 0) {
+            auto reading = std::async(std::launch::async, fill, std::ref(next), cur.begin + cur.n);
+            auto writing = std::async(std::launch::async, [&]() {
+                loader.add((uint32_t)(first_id + cur.begin), cur.vecs.data(), cur.n);
+            });
+
+            parallel_for(0, cur.n, num_threads, [&](size_t i) {
+                const float* v = cur.vecs.data() + i * dim;
+                if (qspace) {
+                    char* code = codes.data() + i * code_size;
+                    qspace->encode(v, code);
+                    appr_alg.addPoint(code, first_id + cur.begin + i);
+                } else if (mvspace) {
+                    char* elem = codes.data() + i * code_size;
+                    memcpy(elem, v, dim * sizeof(float));
+                    mvspace->set_doc_id(elem, cur.docs[i]);
+                    appr_alg.addPoint(elem, first_id + cur.begin + i);
+                } else {
+                    appr_alg.addPoint(v, first_id + cur.begin + i);
+                }
+            });
+            writing.get();
+            reading.get();
+
+            done = cur.begin + cur.n;
+            double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+            double rate = done / std::max(sec, 1e-9);
+            std::cerr << "added " << done << "/" << N << " points (" << (done * 100 / N) << "%), "
+                      << (size_t)rate << " vec/s, elapsed " << (size_t)sec << "s, eta "
+                      << (size_t)((N - done) / std::max(rate, 1e-9)) << "s\n";
+            std::swap(cur, next);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "build failed after " << done << " points: " << e.what() << "\n";
+        delete db;
+        return 1;
     }
+    double build_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+    std::cerr << "build done: " << done << " points in " << build_sec << "s ("
+              << (size_t)(done / std::max(build_sec, 1e-9)) << " vec/s, " << num_threads << " threads)\n";
+    loader.finish();
 
-    appr_alg.saveIndex(graph_out);
+    if (page_aligned) appr_alg.saveIndexPageAligned(graph_out);
+    else appr_alg.saveIndex(graph_out);
     std::cerr << "HNSW index saved to " << graph_out << std::endl;
 
     export_adjacency(appr_alg, graph_out + ".adj");
@@ -0,0 +1,184 @@
+#include "bulk_loader.h"
+#include <rocksdb/sst_file_writer.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+// 与 key 的字节序比较顺序一致的整数：把 key 的 4 个字节按大端拼起来
+static uint32_t key_order(uint32_t id)
+{
+    unsigned char b[sizeof(id)];
+    memcpy(b, &id, sizeof(id));
+    return (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | uint32_t(b[3]);
+}
+
+void BulkLoader::tune_options(rocksdb::Options& options, size_t num_threads)
+{
+    // 导入期间不做自动 compaction，也不因 L0 文件多而限速，结束时手动整理一次。
+    // PrepareForBulkLoad 还会把 num_levels 改成 2，已有更多层的数据库会打不开，这里保持默认
+    int num_levels = options.num_levels;
+    options.PrepareForBulkLoad();
+    options.num_levels = num_levels;
+    options.IncreaseParallelism(static_cast<int>(std::max<size_t>(num_threads, 2)));
+    options.max_subcompactions = static_cast<uint32_t>(std::max<size_t>(num_threads, 1));
+}
+
+BulkLoader::BulkLoader(rocksdb::DB* db, const rocksdb::Options& options, Mode mode, size_t dim,
+                       const std::string& sst_dir, size_t num_threads, size_t buffer_vectors)
+    : db_(db), options_(options), mode_(mode), dim_(dim), sst_dir_(sst_dir),
+      num_threads_(std::min<size_t>(std::max<size_t>(num_threads, 1), 256)),
+      buffer_vectors_(std::max<size_t>(buffer_vectors, 1))
+{
+    if (mode_ == Mode::Sst) {
+        std::error_code ec;
+        created_dir_ = std::filesystem::create_directories(sst_dir_, ec);
+        if (ec) {
+            std::cerr << "bulk load: cannot create " << sst_dir_ << " (" << ec.message()
+                      << "), falling back to WriteBatch\n";
+            mode_ = Mode::Batch;
+        } else {
+            buffer_.resize(buffer_vectors_ * dim_);
+        }
+    }
+}
+
+BulkLoader::~BulkLoader()
+{
+    if (created_dir_) {
+        std::error_code ec;
+        std::filesystem::remove(sst_dir_, ec);  // 导入后文件已被移走，这里只删空目录
+    }
+}
+
+void BulkLoader::add(uint32_t first_id, const float* vecs, size_t n)
+{
+    while (n > 0) {
+        if (mode_ == Mode::Batch) {
+            write_batch(first_id, vecs, n);
+            return;
+        }
+        // 缓冲区只存 id 连续的一段，不连续时先写出
+        if (buffered_ > 0 && first_id != buffer_first_id_ + buffered_) {
+            if (!flush_sst()) continue;
+        }
+        if (buffered_ == 0) buffer_first_id_ = first_id;
+        size_t take = std::min(n, buffer_vectors_ - buffered_);
+        memcpy(buffer_.data() + buffered_ * dim_, vecs, take * dim_ * sizeof(float));
+        buffered_ += take;
+        first_id += static_cast<uint32_t>(take);
+        vecs += take * dim_;
+        n -= take;
+        if (buffered_ == buffer_vectors_) flush_sst();
+    }
+}
+
+// 写出缓冲区中的一批。失败时退回 Batch 模式并用 WriteBatch 写这一批，返回 false
+bool BulkLoader::flush_sst()
+{
+    if (buffered_ == 0) return true;
+    auto t0 = std::chrono::steady_clock::now();
+
+    // key 按字节比较，首字节决定所在的段，段与段之间没有重叠，可以一次导入
+    size_t parts = num_threads_;
+    std::vector<std::vector<uint32_t>> part_ids(parts);
+    for (size_t i = 0; i < buffered_; i++) {
+        uint32_t id = buffer_first_id_ + static_cast<uint32_t>(i);
+        part_ids[(key_order(id) >> 24) * parts / 256].push_back(id);
+    }
+
+    std::vector<std::string> files(parts);
+    std::vector<std::string> errors(parts);
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < parts; p++) {
+        if (part_ids[p].empty()) continue;
+        threads.emplace_back([&, p]() {
+            auto& ids = part_ids[p];
+            std::sort(ids.begin(), ids.end(),
+                      [](uint32_t a, uint32_t b) { return key_order(a) < key_order(b); });
+            std::string path = sst_dir_ + "/batch" + std::to_string(sst_batches_) + "_" + std::to_string(p) + ".sst";
+            rocksdb::SstFileWriter writer(rocksdb::EnvOptions(), options_);
+            rocksdb::Status s = writer.Open(path);
+            for (size_t i = 0; s.ok() && i < ids.size(); i++) {
+                uint32_t id = ids[i];
+                const float* v = buffer_.data() + (size_t)(id - buffer_first_id_) * dim_;
+                s = writer.Put(rocksdb::Slice(reinterpret_cast<const char*>(&id), sizeof(id)),
+                               rocksdb::Slice(reinterpret_cast<const char*>(v), dim_ * sizeof(float)));
+            }
+            if (s.ok()) s = writer.Finish();
+            if (s.ok()) files[p] = path;
+            else errors[p] = s.ToString();
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    std::vector<std::string> paths;
+    std::string error;
+    for (size_t p = 0; p < parts; p++) {
+        if (!files[p].empty()) paths.push_back(files[p]);
+        if (!errors[p].empty() && error.empty()) error = "write sst: " + errors[p];
+    }
+    if (error.empty()) {
+        rocksdb::IngestExternalFileOptions ifo;
+        ifo.move_files = true;
+        rocksdb::Status s = db_->IngestExternalFile(paths, ifo);
+        if (!s.ok()) error = "ingest: " + s.ToString();
+    }
+    for (auto& path : paths) {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+
+    if (!error.empty()) {
+        std::cerr << "bulk load: " << error << ", falling back to WriteBatch\n";
+        mode_ = Mode::Batch;
+        write_batch(buffer_first_id_, buffer_.data(), buffered_);
+        buffered_ = 0;
+        std::vector<float>().swap(buffer_);
+        return false;
+    }
+
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cerr << "bulk load: ingested " << buffered_ << " vectors in " << paths.size() << " sst files ("
+              << sec << "s)\n";
+    sst_batches_++;
+    buffered_ = 0;
+    return true;
+}
+
+void BulkLoader::write_batch(uint32_t first_id, const float* vecs, size_t n)
+{
+    rocksdb::WriteBatch batch;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t id = first_id + static_cast<uint32_t>(i);
+        batch.Put(rocksdb::Slice(reinterpret_cast<const char*>(&id), sizeof(id)),
+                  rocksdb::Slice(reinterpret_cast<const char*>(vecs + i * dim_), dim_ * sizeof(float)));
+    }
+    // 没有 WAL，finish() 里的 Flush 之前进程退出会丢数据；建库中途失败本来就要重建
+    rocksdb::WriteOptions wo;
+    wo.disableWAL = true;
+    rocksdb::Status s = db_->Write(wo, &batch);
+    if (!s.ok()) throw std::runtime_error("RocksDB write failed: " + s.ToString());
+    batch_written_ = true;
+}
+
+void BulkLoader::finish()
+{
+    if (mode_ == Mode::Sst) flush_sst();
+
+    auto t0 = std::chrono::steady_clock::now();
+    if (batch_written_) {
+        rocksdb::Status s = db_->Flush(rocksdb::FlushOptions());
+        if (!s.ok()) throw std::runtime_error("RocksDB flush failed: " + s.ToString());
+    }
+    // 各批导入的文件 key 范围重叠，全部堆在 L0，整理一次后读取才只查一个文件
+    rocksdb::CompactRangeOptions cro;
+    rocksdb::Status s = db_->CompactRange(cro, nullptr, nullptr);
+    if (!s.ok()) throw std::runtime_error("RocksDB compaction failed: " + s.ToString());
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cerr << "bulk load: " << mode_name(mode_) << " mode, " << sst_batches_ << " sst batches, compacted in "
+              << sec << "s\n";
+}
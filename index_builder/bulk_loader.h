@@ -0,0 +1,55 @@
+#pragma once
+#include <rocksdb/db.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 把建图时生成的向量批量写入 RocksDB，key 与 storage_service 一致（4 字节 id，本机字节序）
+//
+// Sst 模式：向量先攒在内存里，攒满后按 key 的首字节分成 num_threads 段，
+// 每段排序后由一个线程用 SstFileWriter 写成 SST 文件，再一次 IngestExternalFile 导入，
+// 不经过 WAL 和 memtable。各批次的 key 范围互相重叠，导入的文件都落在 L0，
+// finish() 时统一 CompactRange 一次。
+// Batch 模式：每次 add() 一个 WriteBatch，关闭 WAL，finish() 时 Flush 落盘再整理。
+// SST 写入或导入失败时自动退回 Batch 模式，失败的那一批用 Batch 重写。
+class BulkLoader
+{
+    public:
+        enum class Mode { Sst, Batch };
+
+        // sst_dir：临时 SST 文件目录，需与数据库在同一文件系统上（导入时移动而不是复制）
+        // buffer_vectors：Sst 模式下每批的向量条数
+        BulkLoader(rocksdb::DB* db, const rocksdb::Options& options, Mode mode, size_t dim,
+                   const std::string& sst_dir, size_t num_threads, size_t buffer_vectors);
+        ~BulkLoader();
+
+        // 打开数据库前调整选项：导入期间关闭自动 compaction，结束时的整理用 num_threads 个线程
+        static void tune_options(rocksdb::Options& options, size_t num_threads);
+
+        // 追加 n 条 id 从 first_id 开始连续的向量
+        void add(uint32_t first_id, const float* vecs, size_t n);
+        // 写出剩余数据并整理 LSM，之后数据库可以直接交给 storage_service
+        void finish();
+
+        Mode mode() const { return mode_; }
+        static const char* mode_name(Mode m) { return m == Mode::Sst ? "sst" : "batch"; }
+
+    private:
+        bool flush_sst();
+        void write_batch(uint32_t first_id, const float* vecs, size_t n);
+
+        rocksdb::DB* db_;
+        rocksdb::Options options_;
+        Mode mode_;
+        size_t dim_;
+        std::string sst_dir_;
+        size_t num_threads_;
+        size_t buffer_vectors_;
+
+        uint32_t buffer_first_id_ = 0;
+        size_t buffered_ = 0;
+        std::vector<float> buffer_;
+        size_t sst_batches_ = 0;
+        bool batch_written_ = false;
+        bool created_dir_ = false;
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 把 [start, end) 分给 num_threads 个线程执行 fn(i)，各线程从共享计数器领取下标，
+// 插入耗时不均时也不会有线程提前闲下来。任一线程抛出异常后其余线程尽快停下，异常在调用线程重新抛出
+template<class Function>
+void parallel_for(size_t start, size_t end, size_t num_threads, Function fn) {
+    if (num_threads <= 1) {
+        for (size_t i = start; i < end; i++) fn(i);
+        return;
+    }
+    std::atomic<size_t> current(start);
+    std::exception_ptr last_exception = nullptr;
+    std::mutex last_except_mutex;
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++) {
+        threads.emplace_back([&]() {
+            while (true) {
+                size_t i = current.fetch_add(1);
+                if (i >= end) break;
+                try {
+                    fn(i);
+                } catch (...) {
+                    std::unique_lock<std::mutex> lock(last_except_mutex);
+                    last_exception = std::current_exception();
+                    current = end;
+                    break;
+                }
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    if (last_exception) std::rethrow_exception(last_exception);
+}
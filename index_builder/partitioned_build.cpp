@@ -0,0 +1,386 @@
+#include "partitioned_build.h"
+#include "bulk_loader.h"
+#include "parallel_for.h"
+#include "../hnswlib/hnswlib.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+using hnswlib::labeltype;
+using hnswlib::linklistsizeint;
+using hnswlib::tableint;
+
+namespace {
+
+double seconds_since(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// 输出索引文件。头部和 level-0 区 mmap 到内存，元素下标就是全局 id；上层链接在最后顺序追加
+class IndexFile
+{
+    public:
+        IndexFile(const std::string& path, const hnswlib::HierarchicalNSW<float>& shell, size_t n)
+            : shell_(shell), n_(n)
+        {
+            std::ostringstream header;
+            write_header(header, 0, 0);
+            header_size_ = header.str().size();
+            map_size_ = header_size_ + n_ * shell_.size_data_per_element_;
+
+            fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd_ < 0) throw std::runtime_error("cannot create " + path);
+            if (::ftruncate(fd_, (off_t)map_size_) != 0) throw std::runtime_error("cannot resize " + path);
+            void* p = ::mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+            if (p == MAP_FAILED) throw std::runtime_error("cannot mmap " + path);
+            map_ = static_cast<char*>(p);
+        }
+
+        ~IndexFile()
+        {
+            if (map_) ::munmap(map_, map_size_);
+            if (fd_ >= 0) ::close(fd_);
+        }
+
+        char* element(size_t id) const { return map_ + header_size_ + id * shell_.size_data_per_element_; }
+        float* data(size_t id) const { return reinterpret_cast<float*>(element(id) + shell_.offsetData_); }
+        linklistsizeint* links0(size_t id) const { return reinterpret_cast<linklistsizeint*>(element(id)); }
+        size_t level0_end() const { return map_size_; }
+
+        // 字段顺序与 HierarchicalNSW::saveIndex 一致，max_elements 与元素数都写 n
+        void write_header(std::ostream& out, int maxlevel, tableint entry) const
+        {
+            hnswlib::writeBinaryPOD(out, shell_.offsetLevel0_);
+            hnswlib::writeBinaryPOD(out, n_);
+            hnswlib::writeBinaryPOD(out, n_);
+            hnswlib::writeBinaryPOD(out, shell_.size_data_per_element_);
+            hnswlib::writeBinaryPOD(out, shell_.label_offset_);
+            hnswlib::writeBinaryPOD(out, shell_.offsetData_);
+            hnswlib::writeBinaryPOD(out, maxlevel);
+            hnswlib::writeBinaryPOD(out, entry);
+            hnswlib::writeBinaryPOD(out, shell_.maxM_);
+            hnswlib::writeBinaryPOD(out, shell_.maxM0_);
+            hnswlib::writeBinaryPOD(out, shell_.M_);
+            hnswlib::writeBinaryPOD(out, shell_.mult_);
+            hnswlib::writeBinaryPOD(out, shell_.ef_construction_);
+        }
+
+        void finish_header(int maxlevel, tableint entry)
+        {
+            std::ostringstream header;
+            write_header(header, maxlevel, entry);
+            memcpy(map_, header.str().data(), header_size_);
+        }
+
+    private:
+        const hnswlib::HierarchicalNSW<float>& shell_;
+        size_t n_;
+        size_t header_size_ = 0;
+        size_t map_size_ = 0;
+        int fd_ = -1;
+        char* map_ = nullptr;
+};
+
+// Lloyd k-means，返回 k * dim 个中心。初始中心取均匀间隔的样本，空簇用随机样本重新开始
+std::vector<float> train_centroids(const std::vector<float>& sample, size_t dim, size_t k,
+                                   hnswlib::L2Space& space, size_t num_threads)
+{
+    auto dist = space.get_dist_func();
+    void* param = space.get_dist_func_param();
+    size_t n = sample.size() / dim;
+    std::vector<float> centroids(k * dim);
+    for (size_t c = 0; c < k; c++)
+        memcpy(&centroids[c * dim], &sample[(c * n / k) * dim], dim * sizeof(float));
+
+    std::mt19937_64 rng(123);
+    std::vector<uint32_t> assign(n);
+    for (int iter = 0; iter < 10; iter++) {
+        parallel_for(0, n, num_threads, [&](size_t i) {
+            float best = std::numeric_limits<float>::max();
+            for (size_t c = 0; c < k; c++) {
+                float d = dist(&sample[i * dim], &centroids[c * dim], param);
+                if (d < best) { best = d; assign[i] = (uint32_t)c; }
+            }
+        });
+        std::vector<double> sums(k * dim, 0.0);
+        std::vector<size_t> counts(k, 0);
+        for (size_t i = 0; i < n; i++) {
+            counts[assign[i]]++;
+            for (size_t d = 0; d < dim; d++) sums[assign[i] * dim + d] += sample[i * dim + d];
+        }
+        for (size_t c = 0; c < k; c++) {
+            if (counts[c] == 0) {
+                memcpy(&centroids[c * dim], &sample[(rng() % n) * dim], dim * sizeof(float));
+                continue;
+            }
+            for (size_t d = 0; d < dim; d++) centroids[c * dim + d] = (float)(sums[c * dim + d] / counts[c]);
+        }
+    }
+    return centroids;
+}
+
+// 与 HierarchicalNSW::getNeighborsByHeuristic2 相同的裁剪：按到 q 的距离从近到远，
+// 候选比已选中的任一邻居离 q 更远于离该邻居时丢弃
+std::vector<tableint> prune_heuristic(const IndexFile& out, const float* q, const std::vector<tableint>& cands,
+                                      size_t max_m, hnswlib::DISTFUNC<float> dist, void* param)
+{
+    std::vector<std::pair<float, tableint>> sorted;
+    sorted.reserve(cands.size());
+    for (tableint c : cands) sorted.emplace_back(dist(q, out.data(c), param), c);
+    std::sort(sorted.begin(), sorted.end());
+
+    std::vector<tableint> kept;
+    for (auto& [d_q, c] : sorted) {
+        if (kept.size() >= max_m) break;
+        bool good = true;
+        for (tableint r : kept) {
+            if (dist(out.data(c), out.data(r), param) < d_q) {
+                good = false;
+                break;
+            }
+        }
+        if (good) kept.push_back(c);
+    }
+    return kept;
+}
+
+void set_links(linklistsizeint* ll, const std::vector<tableint>& ids)
+{
+    *reinterpret_cast<unsigned short*>(ll) = static_cast<unsigned short>(ids.size());
+    memcpy(ll + 1, ids.data(), ids.size() * sizeof(tableint));
+}
+
+std::vector<tableint> get_links(linklistsizeint* ll)
+{
+    unsigned short cnt = *reinterpret_cast<unsigned short*>(ll);
+    tableint* p = reinterpret_cast<tableint*>(ll + 1);
+    return std::vector<tableint>(p, p + cnt);
+}
+
+}  // namespace
+
+bool build_partitioned(const PartitionedBuildConfig& cfg, const std::vector<float>& sample,
+                       const std::function<size_t(float*, size_t)>& next_vectors, BulkLoader& loader)
+{
+    const size_t N = cfg.N, dim = cfg.dim, P = cfg.partitions;
+    const size_t overlap = std::min(std::max<size_t>(cfg.overlap, 1), P);
+    const size_t T = cfg.num_threads;
+    if (N == 0 || sample.size() / dim < P) {
+        std::cerr << "partitioned build: need at least " << P << " vectors\n";
+        return false;
+    }
+
+    hnswlib::L2Space space(dim);
+    auto dist = space.get_dist_func();
+    void* param = space.get_dist_func_param();
+    // 只用来取布局参数（每个元素的大小、各字段偏移），与最终索引相同
+    hnswlib::HierarchicalNSW<float> shell(&space, 1, cfg.M, cfg.ef_construction);
+    const size_t maxM0 = shell.maxM0_, maxM = shell.maxM_;
+    auto t_total = std::chrono::steady_clock::now();
+
+    try {
+        // 1. k-means 分区中心
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<float> centroids = train_centroids(sample, dim, P, space, T);
+        std::cerr << "partitioned build: " << P << " partitions, overlap " << overlap << ", k-means on "
+                  << sample.size() / dim << " vectors (" << seconds_since(t0) << "s)\n";
+
+        // 2. 流式读取：写 RocksDB、写 level-0 区、按最近的 overlap 个中心分配 id
+        IndexFile out(cfg.graph_out, shell, N);
+        std::string part_dir = cfg.graph_out + ".parts";
+        std::filesystem::create_directories(part_dir);
+        auto part_path = [&](size_t p) { return part_dir + "/" + std::to_string(p) + ".ids"; };
+        std::vector<std::ofstream> part_files(P);
+        for (size_t p = 0; p < P; p++) {
+            part_files[p].open(part_path(p), std::ios::binary);
+            if (!part_files[p]) throw std::runtime_error("cannot create " + part_path(p));
+        }
+        std::vector<size_t> part_sizes(P, 0);
+
+        t0 = std::chrono::steady_clock::now();
+        struct Chunk {
+            std::vector<float> vecs;
+            size_t begin = 0;
+            size_t n = 0;
+        };
+        Chunk cur, next;
+        cur.vecs.resize(cfg.chunk * dim);
+        next.vecs.resize(cfg.chunk * dim);
+        auto fill = [&](Chunk& c, size_t begin) {
+            c.begin = begin;
+            c.n = begin < N ? next_vectors(c.vecs.data(), std::min(cfg.chunk, N - begin)) : 0;
+        };
+        std::vector<uint32_t> assign(cfg.chunk * overlap);
+        size_t loaded = 0;
+        fill(cur, 0);
+        while (cur.n > 0) {
+            auto reading = std::async(std::launch::async, fill, std::ref(next), cur.begin + cur.n);
+            auto writing = std::async(std::launch::async, [&]() {
+                loader.add((uint32_t)(cfg.first_label + cur.begin), cur.vecs.data(), cur.n);
+            });
+            parallel_for(0, cur.n, T, [&](size_t i) {
+                const float* v = cur.vecs.data() + i * dim;
+                size_t id = cur.begin + i;
+                memcpy(out.data(id), v, dim * sizeof(float));
+                labeltype label = cfg.first_label + id;
+                memcpy(out.element(id) + shell.label_offset_, &label, sizeof(label));
+
+                std::vector<std::pair<float, uint32_t>> d(P);
+                for (size_t c = 0; c < P; c++) d[c] = {dist(v, &centroids[c * dim], param), (uint32_t)c};
+                std::partial_sort(d.begin(), d.begin() + overlap, d.end());
+                for (size_t o = 0; o < overlap; o++) assign[i * overlap + o] = d[o].second;
+            });
+            for (size_t i = 0; i < cur.n; i++) {
+                uint32_t id = (uint32_t)(cur.begin + i);
+                for (size_t o = 0; o < overlap; o++) {
+                    uint32_t p = assign[i * overlap + o];
+                    part_files[p].write(reinterpret_cast<const char*>(&id), sizeof(id));
+                    part_sizes[p]++;
+                }
+            }
+            writing.get();
+            reading.get();
+            loaded = cur.begin + cur.n;
+            std::swap(cur, next);
+        }
+        for (auto& f : part_files) f.close();
+        std::vector<float>().swap(cur.vecs);
+        std::vector<float>().swap(next.vecs);
+        std::cerr << "partitioned build: streamed " << loaded << " vectors (" << seconds_since(t0) << "s), sizes:";
+        for (size_t p = 0; p < P; p++) std::cerr << " " << part_sizes[p];
+        std::cerr << "\n";
+        if (loaded != N) throw std::runtime_error("input ended after " + std::to_string(loaded) + " vectors");
+
+        // 3. 逐个分区建子图，邻居表合并进 level-0 区
+        size_t merged = 0, pruned = 0;
+        for (size_t p = 0; p < P; p++) {
+            if (part_sizes[p] == 0) continue;
+            t0 = std::chrono::steady_clock::now();
+            std::vector<uint32_t> ids(part_sizes[p]);
+            {
+                std::ifstream in(part_path(p), std::ios::binary);
+                in.read(reinterpret_cast<char*>(ids.data()), ids.size() * sizeof(uint32_t));
+                if (!in) throw std::runtime_error("cannot read " + part_path(p));
+            }
+            std::filesystem::remove(part_path(p));
+
+            hnswlib::HierarchicalNSW<float> sub(&space, ids.size(), cfg.M, cfg.ef_construction, 100 + p);
+            parallel_for(0, ids.size(), T, [&](size_t i) { sub.addPoint(out.data(ids[i]), ids[i]); });
+
+            std::atomic<size_t> part_merged{0}, part_pruned{0};
+            parallel_for(0, sub.cur_element_count, T, [&](size_t u) {
+                tableint g = (tableint)sub.getExternalLabel((tableint)u);
+                std::vector<tableint> fresh = get_links(sub.get_linklist0((tableint)u));
+                for (auto& x : fresh) x = (tableint)sub.getExternalLabel(x);
+
+                linklistsizeint* ll = out.links0(g);
+                std::vector<tableint> links = get_links(ll);
+                if (links.empty()) {
+                    set_links(ll, fresh);
+                    return;
+                }
+                // 边界向量：已有其他分区的邻居，取并集
+                part_merged++;
+                for (tableint x : fresh) {
+                    if (x != g && std::find(links.begin(), links.end(), x) == links.end()) links.push_back(x);
+                }
+                if (links.size() > maxM0) {
+                    part_pruned++;
+                    links = prune_heuristic(out, out.data(g), links, maxM0, dist, param);
+                }
+                set_links(ll, links);
+            });
+            merged += part_merged;
+            pruned += part_pruned;
+            std::cerr << "partitioned build: partition " << p + 1 << "/" << P << " (" << ids.size()
+                      << " vectors) built and merged in " << seconds_since(t0) << "s\n";
+        }
+        std::filesystem::remove(part_dir);
+        std::cerr << "partitioned build: " << merged << " boundary merges, " << pruned << " pruned\n";
+
+        // 4. 上层：每个元素以 1/M 的概率进入 level >= 1。几何分布无记忆，
+        //    上层小图自己抽的层数 + 1 就是这些元素在整个图中的层数
+        t0 = std::chrono::steady_clock::now();
+        std::mt19937_64 rng(100);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::vector<tableint> upper_ids;
+        for (size_t id = 0; id < N; id++) {
+            if (uniform(rng) < 1.0 / cfg.M) upper_ids.push_back((tableint)id);
+        }
+        if (upper_ids.empty()) upper_ids.push_back(0);
+        hnswlib::HierarchicalNSW<float> upper(&space, upper_ids.size(), cfg.M, cfg.ef_construction, 99);
+        parallel_for(0, upper_ids.size(), T, [&](size_t i) { upper.addPoint(out.data(upper_ids[i]), upper_ids[i]); });
+        int maxlevel = upper.maxlevel_ + 1;
+        tableint entry = (tableint)upper.getExternalLabel(upper.enterpoint_node_);
+        std::cerr << "partitioned build: upper layers " << upper_ids.size() << " vectors, max level " << maxlevel
+                  << " (" << seconds_since(t0) << "s)\n";
+
+        // 5. 上层链接按 id 顺序追加在 level-0 区之后，同时导出 .adj（格式见 build.cpp 的 export_adjacency）
+        out.finish_header(maxlevel, entry);
+        std::fstream tail(cfg.graph_out, std::ios::in | std::ios::out | std::ios::binary);
+        tail.seekp((std::streamoff)out.level0_end());
+        std::ofstream adj(cfg.graph_out + ".adj", std::ios::binary);
+        if (!tail || !adj) throw std::runtime_error("cannot write " + cfg.graph_out);
+        uint32_t node_count = (uint32_t)N, maxlevel_u = (uint32_t)maxlevel;
+        uint32_t entry_label = (uint32_t)(cfg.first_label + entry);
+        adj.write(reinterpret_cast<const char*>(&entry_label), sizeof(entry_label));
+        adj.write(reinterpret_cast<const char*>(&maxlevel_u), sizeof(maxlevel_u));
+        adj.write(reinterpret_cast<const char*>(&node_count), sizeof(node_count));
+
+        // .adj 中写 label，索引文件中是内部 id（即 label - first_label）
+        std::vector<uint32_t> nb_labels;
+        auto write_adj_level = [&](const std::vector<tableint>& nb) {
+            uint32_t deg = (uint32_t)nb.size();
+            nb_labels.resize(nb.size());
+            for (size_t j = 0; j < nb.size(); j++) nb_labels[j] = (uint32_t)(cfg.first_label + nb[j]);
+            adj.write(reinterpret_cast<const char*>(&deg), sizeof(deg));
+            adj.write(reinterpret_cast<const char*>(nb_labels.data()), nb_labels.size() * sizeof(uint32_t));
+        };
+        std::vector<char> block;
+        for (size_t id = 0; id < N; id++) {
+            auto it = upper.label_lookup_.find(id);
+            int level = it == upper.label_lookup_.end() ? 0 : upper.element_levels_[it->second] + 1;
+            uint32_t label = (uint32_t)(cfg.first_label + id), levels = (uint32_t)level + 1;
+            adj.write(reinterpret_cast<const char*>(&label), sizeof(label));
+            adj.write(reinterpret_cast<const char*>(&levels), sizeof(levels));
+            write_adj_level(get_links(out.links0(id)));
+
+            unsigned int link_list_size = level > 0 ? (unsigned int)(shell.size_links_per_element_ * level) : 0;
+            hnswlib::writeBinaryPOD(tail, link_list_size);
+            if (!link_list_size) continue;
+            block.assign(link_list_size, 0);
+            for (int l = 1; l <= level; l++) {
+                // 上层小图的第 l-1 层就是整个图的第 l 层；它的第 0 层最多 2M 个邻居，裁剪到 M
+                std::vector<tableint> nb = get_links(upper.get_linklist_at_level(it->second, l - 1));
+                for (auto& x : nb) x = (tableint)upper.getExternalLabel(x);
+                if (nb.size() > maxM) nb = prune_heuristic(out, out.data(id), nb, maxM, dist, param);
+                set_links(reinterpret_cast<linklistsizeint*>(block.data() + (l - 1) * shell.size_links_per_element_), nb);
+                write_adj_level(nb);
+            }
+            tail.write(block.data(), block.size());
+        }
+        tail.close();
+        adj.close();
+        if (!tail || !adj) throw std::runtime_error("failed writing " + cfg.graph_out);
+    } catch (const std::exception& e) {
+        std::cerr << "partitioned build failed: " << e.what() << "\n";
+        return false;
+    }
+
+    std::cerr << "partitioned build: " << N << " points in " << seconds_since(t_total) << "s, index saved to "
+              << cfg.graph_out << "\n";
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+class BulkLoader;
+
+// 分区建图（内存放不下整个 HierarchicalNSW 时使用）
+//
+// 1. 在样本上做 k-means 得到 partitions 个中心；
+// 2. 流式读一遍数据：向量写入 RocksDB，同时直接写进输出索引文件的 level-0 区（文件 mmap 到内存，
+//    由操作系统换页），每条向量按最近的 overlap 个中心分到各分区，分区只记录 id；
+// 3. 逐个分区用 num_threads 个线程建一个只含该分区向量的子图，把子图的 level-0 邻居（换成全局 id）
+//    合并进输出文件。属于多个分区的边界向量会收到多份邻居表，合并后超过 maxM0 的用 HNSW 启发式裁剪，
+//    分区之间就是靠这些边界向量连起来的；
+// 4. 按 1/M 的概率抽出上层元素，单独建一个小图作为 level >= 1 的各层；
+// 5. 写出上层链接和文件头，得到与 saveIndex 格式相同的索引，并导出 .adj。
+// 常驻内存的是一个分区的子图（约 overlap * N / partitions 条）和上层小图（约 N / M 条）。
+struct PartitionedBuildConfig
+{
+    size_t N = 0;
+    size_t dim = 0;
+    size_t M = 16;
+    size_t ef_construction = 200;
+    size_t partitions = 1;
+    size_t overlap = 2;       // 每条向量分到最近的几个分区
+    size_t num_threads = 1;
+    size_t chunk = 10000;     // 流式读取时每块的条数
+    size_t first_label = 0;   // 第 i 条向量的 label 为 first_label + i（分片建图时为分片的起始 id）
+    std::string graph_out;
+};
+
+// sample：k-means 样本（行优先，sample.size() / dim 条）
+// next_vectors(out, n)：按 id 顺序取接下来的 n 条向量，返回实际取到的条数
+// 成功返回 true，失败时打印原因并返回 false
+bool build_partitioned(const PartitionedBuildConfig& cfg, const std::vector<float>& sample,
+                       const std::function<size_t(float*, size_t)>& next_vectors, BulkLoader& loader);
@@ -0,0 +1,173 @@
+#include "vector_reader.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+static std::string extension_format(const std::string& path)
+{
+    std::string ext = std::filesystem::path(path).extension().string();
+    if (ext == ".fvecs" || ext == ".bvecs" || ext == ".npy") return ext.substr(1);
+    return "raw";
+}
+
+// 从 npy 头部的字典字符串中取出 key 对应的值（到下一个逗号或右括号为止）
+static std::string npy_field(const std::string& header, const std::string& key)
+{
+    size_t pos = header.find("'" + key + "'");
+    if (pos == std::string::npos) return {};
+    pos = header.find(':', pos);
+    if (pos == std::string::npos) return {};
+    pos++;
+    while (pos < header.size() && header[pos] == ' ') pos++;
+    size_t end = header[pos] == '(' ? header.find(')', pos) + 1 : header.find_first_of(",}", pos);
+    return header.substr(pos, end - pos);
+}
+
+VectorReader::VectorReader(const std::string& path, std::string format, size_t raw_dim)
+    : path_(path), format_(format.empty() ? extension_format(path) : format)
+{
+    fp_ = std::fopen(path.c_str(), "rb");
+    if (!fp_) throw std::runtime_error("cannot open " + path);
+    size_t file_size = std::filesystem::file_size(path);
+    size_t data_offset = 0;
+
+    if (format_ == "fvecs" || format_ == "bvecs") {
+        // 维度存在每条向量前面，先读第一条的
+        int32_t d = 0;
+        if (std::fread(&d, sizeof(d), 1, fp_) != 1 || d <= 0)
+            throw std::runtime_error(path + ": bad " + format_ + " header");
+        dim_ = (size_t)d;
+        elem_size_ = format_ == "fvecs" ? 4 : 1;
+        row_header_ = sizeof(int32_t);
+    } else if (format_ == "npy") {
+        char magic[8];
+        if (std::fread(magic, 1, 8, fp_) != 8 || std::memcmp(magic, "\x93NUMPY", 6) != 0)
+            throw std::runtime_error(path + ": not a .npy file");
+        size_t header_len = 0;
+        if (magic[6] == 1) {
+            uint16_t len16;
+            if (std::fread(&len16, sizeof(len16), 1, fp_) != 1) throw std::runtime_error(path + ": truncated npy header");
+            header_len = len16;
+            data_offset = 10 + header_len;
+        } else {
+            uint32_t len32;
+            if (std::fread(&len32, sizeof(len32), 1, fp_) != 1) throw std::runtime_error(path + ": truncated npy header");
+            header_len = len32;
+            data_offset = 12 + header_len;
+        }
+        std::string header(header_len, '\0');
+        if (std::fread(header.data(), 1, header_len, fp_) != header_len)
+            throw std::runtime_error(path + ": truncated npy header");
+
+        std::string descr = npy_field(header, "descr");
+        if (descr == "'<f4'") elem_size_ = 4;
+        else if (descr == "'|u1'" || descr == "'u1'") elem_size_ = 1;
+        else throw std::runtime_error(path + ": unsupported npy dtype " + descr + ", expected <f4 or |u1");
+        if (npy_field(header, "fortran_order") != "False")
+            throw std::runtime_error(path + ": fortran-ordered npy arrays are not supported");
+        // shape 形如 (1000000, 128)
+        std::string shape = npy_field(header, "shape");
+        size_t rows = 0, cols = 0;
+        if (std::sscanf(shape.c_str(), "(%zu, %zu)", &rows, &cols) != 2 || cols == 0)
+            throw std::runtime_error(path + ": expected a 2-d npy array, shape " + shape);
+        dim_ = cols;
+        count_ = rows;
+    } else if (format_ == "raw") {
+        if (raw_dim == 0) throw std::runtime_error(path + ": raw float32 input needs the dimension");
+        dim_ = raw_dim;
+    } else {
+        throw std::runtime_error("unknown input format " + format_ + ", expected fvecs, bvecs, npy or raw");
+    }
+
+    size_t row_bytes = row_header_ + dim_ * elem_size_;
+    if (format_ != "npy") {
+        if (file_size % row_bytes != 0)
+            throw std::runtime_error(path + ": size " + std::to_string(file_size) + " is not a multiple of the " +
+                                     std::to_string(row_bytes) + "-byte row");
+        count_ = file_size / row_bytes;
+    } else if (data_offset + count_ * row_bytes > file_size) {
+        throw std::runtime_error(path + ": npy data shorter than its shape");
+    }
+    std::fseek(fp_, (long)data_offset, SEEK_SET);
+}
+
+VectorReader::~VectorReader()
+{
+    if (fp_) std::fclose(fp_);
+}
+
+size_t VectorReader::read(float* out, size_t max_n)
+{
+    size_t n = std::min(max_n, count_ - read_);
+    if (n == 0) return 0;
+    size_t row_bytes = row_header_ + dim_ * elem_size_;
+
+    if (row_header_ == 0 && elem_size_ == sizeof(float)) {
+        // raw 和 float32 npy 直接读进调用方的缓冲区
+        if (std::fread(out, row_bytes, n, fp_) != n) throw std::runtime_error(path_ + ": short read");
+    } else {
+        staging_.resize(n * row_bytes);
+        if (std::fread(staging_.data(), row_bytes, n, fp_) != n) throw std::runtime_error(path_ + ": short read");
+        for (size_t i = 0; i < n; i++) {
+            const char* row = staging_.data() + i * row_bytes;
+            if (row_header_) {
+                int32_t d;
+                std::memcpy(&d, row, sizeof(d));
+                if ((size_t)d != dim_)
+                    throw std::runtime_error(path_ + ": vector " + std::to_string(read_ + i) + " has dim " +
+                                             std::to_string(d) + ", expected " + std::to_string(dim_));
+            }
+            const char* data = row + row_header_;
+            float* dst = out + i * dim_;
+            if (elem_size_ == sizeof(float)) {
+                std::memcpy(dst, data, dim_ * sizeof(float));
+            } else {
+                const uint8_t* src = reinterpret_cast<const uint8_t*>(data);
+                for (size_t d = 0; d < dim_; d++) dst[d] = src[d];
+            }
+        }
+    }
+    read_ += n;
+    return n;
+}
+
+void VectorReader::skip(size_t n)
+{
+    n = std::min(n, count_ - read_);
+    size_t row_bytes = row_header_ + dim_ * elem_size_;
+    if (n > 0 && fseeko(fp_, (off_t)(n * row_bytes), SEEK_CUR) != 0)
+        throw std::runtime_error(path_ + ": seek failed");
+    read_ += n;
+}
+
+DocIdReader::DocIdReader(const std::string& path) : path_(path)
+{
+    fp_ = std::fopen(path.c_str(), "rb");
+    if (!fp_) throw std::runtime_error("cannot open " + path);
+    size_t file_size = std::filesystem::file_size(path);
+    if (file_size % sizeof(uint32_t) != 0)
+        throw std::runtime_error(path + ": size " + std::to_string(file_size) + " is not a multiple of 4 (uint32 doc ids)");
+    count_ = file_size / sizeof(uint32_t);
+}
+
+DocIdReader::~DocIdReader()
+{
+    if (fp_) std::fclose(fp_);
+}
+
+size_t DocIdReader::read(uint32_t* out, size_t max_n)
+{
+    size_t n = std::min(max_n, count_ - read_);
+    if (n > 0 && std::fread(out, sizeof(uint32_t), n, fp_) != n) throw std::runtime_error(path_ + ": short read");
+    read_ += n;
+    return n;
+}
+
+void DocIdReader::skip(size_t n)
+{
+    n = std::min(n, count_ - read_);
+    if (n > 0 && fseeko(fp_, (off_t)(n * sizeof(uint32_t)), SEEK_CUR) != 0)
+        throw std::runtime_error(path_ + ": seek failed");
+    read_ += n;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// 按块顺序读取向量数据集，内存占用只与每次读取的条数有关
+// 支持的格式：
+//   fvecs：每条 int32 dim + dim 个 float32（SIFT/GIST 等数据集的格式）
+//   bvecs：每条 int32 dim + dim 个 uint8，读出时转成 float
+//   npy：  二维数组，dtype 为 <f4 或 |u1，C 顺序
+//   raw：  连续的 float32，没有头，维度由调用方给出
+// 格式或内容不对时抛出 std::runtime_error
+class VectorReader
+{
+    public:
+        // format 为空时按扩展名判断；raw_dim 只在 raw 格式下使用
+        VectorReader(const std::string& path, std::string format, size_t raw_dim);
+        ~VectorReader();
+
+        size_t dim() const { return dim_; }
+        // 文件中的向量总数
+        size_t count() const { return count_; }
+        const std::string& format() const { return format_; }
+
+        // 读取最多 max_n 条向量到 out（max_n * dim 个 float），返回实际读到的条数，0 表示读完
+        size_t read(float* out, size_t max_n);
+
+        // 跳过接下来的 n 条向量（不超过剩余条数）
+        void skip(size_t n);
+
+    private:
+        FILE* fp_ = nullptr;
+        std::string path_;
+        std::string format_;
+        size_t dim_ = 0;
+        size_t count_ = 0;
+        size_t read_ = 0;
+        size_t elem_size_ = 4;     // 每个分量的字节数，4 或 1
+        size_t row_header_ = 0;    // 每条向量前的字节数（fvecs/bvecs 为 4）
+        std::vector<char> staging_;
+};
+
+// 多向量索引中每条向量所属的文档 id：连续的 uint32 小端整数，与数据集中的向量按顺序一一对应，
+// 没有头（numpy 可用 ids.astype('<u4').tofile(path) 生成）
+class DocIdReader
+{
+    public:
+        explicit DocIdReader(const std::string& path);
+        ~DocIdReader();
+
+        size_t count() const { return count_; }
+
+        // 读取最多 max_n 个 id，返回实际读到的个数
+        size_t read(uint32_t* out, size_t max_n);
+        void skip(size_t n);
+
+    private:
+        FILE* fp_ = nullptr;
+        std::string path_;
+        size_t count_ = 0;
+        size_t read_ = 0;
+};
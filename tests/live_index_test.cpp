@@ -0,0 +1,125 @@
+// LiveIndex 过滤搜索的回归测试：暴力路径（search_ids）与图上过滤（search + isIdAllowed）结果一致
+// 每种空间各建一个小索引，ef 取元素总数，图上搜索在这样的规模下等同于精确搜索
+#include "../hnsw_service/live_index.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                          \
+    do {                                          \
+        if (!(cond)) {                            \
+            std::fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+            std::fprintf(stderr, __VA_ARGS__);    \
+            std::fprintf(stderr, "\n");           \
+            failures++;                           \
+        }                                         \
+    } while (0)
+
+class IdSetFilter : public hnswlib::BaseFilterFunctor {
+public:
+    explicit IdSetFilter(const std::unordered_set<uint32_t>& ids) : ids_(ids) {}
+    bool operator()(hnswlib::labeltype id) override { return ids_.count((uint32_t)id) != 0; }
+
+private:
+    const std::unordered_set<uint32_t>& ids_;
+};
+
+// 与 index_builder --quant 相同：训练参数，存编码后的向量
+static void build_index(const std::string& path, const std::string& quant, size_t dim, const std::vector<float>& data, size_t n)
+{
+    std::unique_ptr<hnswlib::SpaceInterface<float>> space;
+    hnswlib::QuantizedSpace* qspace = nullptr;
+    if (quant.empty()) {
+        space = std::make_unique<hnswlib::L2Space>(dim);
+    } else if (quant == "sq8") {
+        auto sq8 = std::make_unique<hnswlib::SQ8Space>(dim);
+        sq8->train(data.data(), n);
+        sq8->saveParams(path + ".sq8");
+        qspace = sq8.get();
+        space = std::move(sq8);
+    } else if (quant == "fp16") {
+        auto fp16 = std::make_unique<hnswlib::FP16Space>(dim);
+        qspace = fp16.get();
+        space = std::move(fp16);
+    } else {
+        auto pq = std::make_unique<hnswlib::PQSpace>(dim, dim / 4);
+        pq->train(data.data(), n);
+        pq->saveParams(path + ".pq");
+        qspace = pq.get();
+        space = std::move(pq);
+    }
+    hnswlib::HierarchicalNSW<float> hnsw(space.get(), n, 16, 100);
+    std::vector<char> code(space->get_data_size());
+    for (size_t i = 0; i < n; i++) {
+        const float* v = data.data() + i * dim;
+        if (qspace) {
+            qspace->encode(v, code.data());
+            hnsw.addPoint(code.data(), i);
+        } else {
+            hnsw.addPoint(v, i);
+        }
+    }
+    hnsw.saveIndex(path);
+}
+
+static void test_filtered_search(const std::string& quant)
+{
+    const size_t dim = 16, n = 500, k = 10;
+    std::mt19937 rng(42);
+    std::normal_distribution<float> normal;
+    std::vector<float> data(n * dim);
+    for (float& x : data) x = normal(rng);
+
+    std::string path = "live_index_test_" + (quant.empty() ? std::string("float") : quant) + ".bin";
+    build_index(path, quant, dim, data, n);
+    LiveIndex index((int)dim, path, false, false, quant);
+
+    // 每 7 个取一个，模拟严格的过滤条件
+    std::vector<uint32_t> ids;
+    for (uint32_t i = 0; i < n; i += 7) ids.push_back(i);
+    std::unordered_set<uint32_t> id_set(ids.begin(), ids.end());
+    IdSetFilter filter(id_set);
+
+    for (size_t q = 0; q < 20; q++) {
+        std::vector<float> query(dim);
+        for (float& x : query) x = normal(rng);
+
+        auto brute = index.search_ids(query.data(), k, ids, nullptr);
+        hnswlib::SearchParams sp;
+        sp.ef = n;
+        sp.isIdAllowed = &filter;
+        auto graph = index.search(query.data(), k, sp);
+
+        CHECK(brute.size() == k && graph.size() == k, "[%s] query %zu: %zu brute-force vs %zu graph results",
+              quant.c_str(), q, brute.size(), graph.size());
+        while (!brute.empty() && !graph.empty()) {
+            auto [bd, bl] = brute.top();
+            auto [gd, gl] = graph.top();
+            CHECK(id_set.count((uint32_t)bl), "[%s] query %zu: id %zu is not in the filter", quant.c_str(), q, (size_t)bl);
+            CHECK(std::fabs(bd - gd) <= 1e-4f * std::max(1.0f, std::fabs(gd)),
+                  "[%s] query %zu: brute-force distance %g (id %zu) != graph distance %g (id %zu)", quant.c_str(), q,
+                  bd, (size_t)bl, gd, (size_t)gl);
+            brute.pop();
+            graph.pop();
+        }
+    }
+    std::remove(path.c_str());
+    std::remove((path + ".sq8").c_str());
+    std::remove((path + ".pq").c_str());
+}
+
+int main()
+{
+    for (const char* quant : {"", "sq8", "fp16", "pq"}) test_filtered_search(quant);
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("live_index_test: all checks passed\n");
+    return 0;
+}
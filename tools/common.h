@@ -12,6 +12,20 @@ struct VecHeader {
 vid_t id;
 dim_t dim;
 };
+
+// /search 二进制请求（Content-Type: application/octet-stream）
+// 请求体：SearchReqHeader + dim 个 float32（小端）
+struct SearchReqHeader {
+uint32_t k;
+uint32_t ef;   // 0 表示使用服务端默认值
+dim_t dim;
+};
+
+// /search 二进制响应：uint32_t count + count 个 SearchResultEntry
+struct SearchResultEntry {
+vid_t id;
+float distance;
+};
 // 浮点数向量转化为字符串
 inline std::string vec_to_bytes(const std::vector<float>& v) 
 {
@@ -0,0 +1,203 @@
+// groundtruth - 为查询集计算精确的 top-k，写出标准的 .ivecs/.fvecs 真值文件，供召回率测量使用
+//
+// 用法：groundtruth --base <RocksDB 目录或数据集文件> --queries <查询文件> --out <前缀> [选项]
+//   --base        RocksDB 目录（index_builder/storage_service 写出的，key 为 uint32 id，value 为 float32 向量），
+//                 或 fvecs/bvecs/npy/raw 数据集文件（第 i 条的 id 为 i，与 index_builder --input 一致）
+//   --format      数据集文件的格式，默认按扩展名判断；raw 需要 --dim
+//   --queries     查询文件，格式同上（--query-format 指定格式）
+//   --k           每个查询取多少个最近邻，默认 100
+//   --metric      l2（默认，L2 平方距离，与 hnsw_service 一致）或 ip（1 - 内积）
+//   --threads     线程数，默认全部核
+//   --chunk       每次载入内存的向量条数，默认 1000000；底库按块扫描，内存只与块大小有关
+//   --out         写出 <前缀>.ivecs（每个查询 k 个 id，int32）和 <前缀>.fvecs（对应的距离）
+//
+// 精确搜索用 hnswlib::BruteforceSearch::searchKnnBatch（分块、多线程、SIMD 距离核函数），
+// 底库按块扫描，每块的 top-k 与已有结果合并
+#include "../hnswlib/hnswlib.h"
+#include "../index_builder/vector_reader.h"
+#include <rocksdb/db.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Neighbor = std::pair<float, hnswlib::labeltype>;
+
+// 按块提供底库向量：fn(ids, vecs, n) 每块调用一次
+using ChunkFn = std::function<void(const std::vector<uint32_t>&, const std::vector<float>&, size_t)>;
+
+// RocksDB 中 value 长度不等于 dim * 4 的条目跳过并计数；dim 为 0 时取第一条的维度
+static size_t scan_rocksdb(const std::string& path, size_t& dim, size_t chunk, const ChunkFn& fn)
+{
+    rocksdb::Options options;
+    rocksdb::DB* db = nullptr;
+    // 只读打开，storage_service 运行时也可以扫描
+    rocksdb::Status s = rocksdb::DB::OpenForReadOnly(options, path, &db);
+    if (!s.ok()) throw std::runtime_error("cannot open RocksDB " + path + ": " + s.ToString());
+    std::unique_ptr<rocksdb::DB> guard(db);
+
+    rocksdb::ReadOptions ro;
+    ro.fill_cache = false;  // 顺序扫一遍，不污染块缓存
+    std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(ro));
+    std::vector<uint32_t> ids;
+    std::vector<float> vecs;
+    size_t skipped = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        rocksdb::Slice key = it->key(), val = it->value();
+        if (key.size() != sizeof(uint32_t)) {
+            skipped++;
+            continue;
+        }
+        if (dim == 0) dim = val.size() / sizeof(float);
+        if (dim == 0 || val.size() != dim * sizeof(float)) {
+            skipped++;
+            continue;
+        }
+        uint32_t id;
+        memcpy(&id, key.data(), sizeof(id));
+        ids.push_back(id);
+        size_t off = vecs.size();
+        vecs.resize(off + dim);
+        memcpy(vecs.data() + off, val.data(), val.size());
+        if (ids.size() == chunk) {
+            fn(ids, vecs, ids.size());
+            ids.clear();
+            vecs.clear();
+        }
+    }
+    if (!it->status().ok()) throw std::runtime_error("RocksDB scan failed: " + it->status().ToString());
+    if (!ids.empty()) fn(ids, vecs, ids.size());
+    return skipped;
+}
+
+static void scan_file(const std::string& path, const std::string& format, size_t& dim, size_t chunk, const ChunkFn& fn)
+{
+    VectorReader reader(path, format, dim);
+    dim = reader.dim();
+    std::vector<uint32_t> ids;
+    std::vector<float> vecs(chunk * dim);
+    size_t first = 0;
+    while (size_t n = reader.read(vecs.data(), chunk)) {
+        ids.resize(n);
+        for (size_t i = 0; i < n; i++) ids[i] = (uint32_t)(first + i);
+        fn(ids, vecs, n);
+        first += n;
+    }
+}
+
+// 每行 int32 k + k 个元素，elem 取出第 q 行第 i 个元素的 4 字节
+template <typename T, typename Elem>
+static void write_vecs(const std::string& path, const std::vector<std::vector<Neighbor>>& rows, Elem elem)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("cannot open " + path);
+    for (const auto& row : rows) {
+        int32_t n = (int32_t)row.size();
+        out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        for (const auto& e : row) {
+            T v = elem(e);
+            out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+        }
+    }
+    if (!out) throw std::runtime_error("write to " + path + " failed");
+}
+
+int main(int argc, char** argv)
+{
+    std::string base, base_format, queries_path, query_format, out_prefix, metric = "l2";
+    size_t dim = 0, k = 100, chunk = 1000000;
+    size_t num_threads = std::max<unsigned>(std::thread::hardware_concurrency(), 1);
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--base" && i + 1 < argc) base = argv[++i];
+        else if (a == "--format" && i + 1 < argc) base_format = argv[++i];
+        else if (a == "--dim" && i + 1 < argc) dim = std::stoul(argv[++i]);
+        else if (a == "--queries" && i + 1 < argc) queries_path = argv[++i];
+        else if (a == "--query-format" && i + 1 < argc) query_format = argv[++i];
+        else if (a == "--k" && i + 1 < argc) k = std::stoul(argv[++i]);
+        else if (a == "--metric" && i + 1 < argc) metric = argv[++i];
+        else if (a == "--threads" && i + 1 < argc) num_threads = std::max<size_t>(std::stoul(argv[++i]), 1);
+        else if (a == "--chunk" && i + 1 < argc) chunk = std::max<size_t>(std::stoul(argv[++i]), 1);
+        else if (a == "--out" && i + 1 < argc) out_prefix = argv[++i];
+        else {
+            std::cerr << "unknown argument " << a << "\n";
+            return 1;
+        }
+    }
+    if (base.empty() || queries_path.empty() || out_prefix.empty() || k == 0) {
+        std::cerr << "usage: groundtruth --base <rocksdb dir | dataset> --queries <file> --out <prefix> "
+                     "[--k 100] [--metric l2|ip] [--format F] [--query-format F] [--dim D] [--threads N] [--chunk N]\n";
+        return 1;
+    }
+    if (metric != "l2" && metric != "ip") {
+        std::cerr << "unknown --metric " << metric << ", expected l2 or ip\n";
+        return 1;
+    }
+
+    try {
+        VectorReader qreader(queries_path, query_format, dim);
+        size_t qdim = qreader.dim();
+        size_t nq = qreader.count();
+        std::vector<float> queries(nq * qdim);
+        qreader.read(queries.data(), nq);
+        std::cerr << "queries " << queries_path << ": " << nq << " x " << qdim << "\n";
+        if (dim == 0) dim = qdim;
+
+        std::vector<std::vector<Neighbor>> best(nq);
+        std::unique_ptr<hnswlib::SpaceInterface<float>> space;
+        size_t scanned = 0;
+        auto t_start = std::chrono::steady_clock::now();
+
+        auto search_chunk = [&](const std::vector<uint32_t>& ids, const std::vector<float>& vecs, size_t n) {
+            if (dim != qdim)
+                throw std::runtime_error("base dim " + std::to_string(dim) + " != query dim " + std::to_string(qdim));
+            if (!space) {
+                if (metric == "ip") space = std::make_unique<hnswlib::InnerProductSpace>(dim);
+                else space = std::make_unique<hnswlib::L2Space>(dim);
+                std::cerr << "distance kernel: " << space->get_simd_level() << ", " << num_threads << " threads\n";
+            }
+            hnswlib::BruteforceSearch<float> bf(space.get(), n);
+            for (size_t i = 0; i < n; i++) bf.addPoint(vecs.data() + i * dim, ids[i]);
+            auto found = bf.searchKnnBatch(queries.data(), nq, k, num_threads);
+            // 与前面各块的结果合并，距离相同时按 id 排
+            for (size_t q = 0; q < nq; q++) {
+                auto& row = best[q];
+                row.insert(row.end(), found[q].begin(), found[q].end());
+                size_t m = std::min(k, row.size());
+                std::partial_sort(row.begin(), row.begin() + m, row.end());
+                row.resize(m);
+            }
+            scanned += n;
+            double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+            std::cerr << "scanned " << scanned << " vectors, " << (size_t)(scanned / std::max(sec, 1e-9))
+                      << " vec/s, elapsed " << (size_t)sec << "s\n";
+        };
+
+        if (std::filesystem::is_directory(base)) {
+            size_t skipped = scan_rocksdb(base, dim, chunk, search_chunk);
+            if (skipped) std::cerr << "skipped " << skipped << " RocksDB entries with a different key or value size\n";
+        } else {
+            scan_file(base, base_format, dim, chunk, search_chunk);
+        }
+        if (scanned == 0) throw std::runtime_error("no base vectors in " + base);
+        if (scanned < k) std::cerr << "warning: only " << scanned << " base vectors, rows have fewer than k ids\n";
+
+        write_vecs<int32_t>(out_prefix + ".ivecs", best, [](const Neighbor& e) { return (int32_t)e.second; });
+        write_vecs<float>(out_prefix + ".fvecs", best, [](const Neighbor& e) { return e.first; });
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+        std::cerr << "wrote " << out_prefix << ".ivecs/.fvecs: " << nq << " queries x top-" << k << " over "
+                  << scanned << " vectors in " << sec << "s\n";
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,426 @@
+// hnsw_bench - 在进程内对已保存的索引跑 ANN 基准：扫参数，测 recall@k、1..N 线程的 QPS、延迟分位数和内存
+//
+// 用法：hnsw_bench --index <索引文件> --queries <查询文件> --gt <真值 .ivecs> [选项]
+//   --mode        hnsw（默认，LiveIndex 把整个索引载入内存，与 hnsw_service 普通模式相同）
+//                 或 optimized（HNSWGraph 读 <索引>.adj，向量从 --storage 的 storage_service 读取，与优化模式相同）
+//   --dim         向量维度，默认取查询文件的维度
+//   --quant       sq8|fp16|pq，hnsw 模式加载压缩索引；--mmap 1 只读映射按页对齐的索引
+//   --storage     optimized 模式的 storage_service 地址，默认 http://127.0.0.1:8081
+//   --k           recall@k 的 k，默认 10
+//   --ef          逗号分隔的 ef 列表，默认 10,20,40,80,120,200,400,800
+//   --cache       optimized 模式逗号分隔的向量缓存大小列表，默认 0；每个取值开始前清空缓存
+//   --threads     逗号分隔的线程数列表，默认 1,2,4,... 直到本机核数
+//   --runs        每个配置跑几遍，取 QPS 最高的一遍（ann-benchmarks 的做法），默认 1
+//   --warmup      每个配置正式计时前先不计时地跑多少个查询，默认 0
+//   --max-queries 最多使用多少个查询，0 为全部
+//   --out         结果文件，扩展名为 .csv 时写 CSV，否则写 JSON；不论是否指定都在标准输出打印表格
+//
+// 查询文件为 fvecs/bvecs/npy（--query-format 可指定），真值为 tools/groundtruth 写出的 .ivecs，
+// 第 i 行对应第 i 个查询，取前 k 个 id 计算 recall。
+// 每个配置的所有查询分给各线程，从共享计数器领取；QPS 为查询数 / 墙钟时间，延迟为单个查询的耗时。
+// 输出字段仿照 ann-benchmarks：algorithm、parameters、recall、qps 以及延迟分位数，
+// 另外标出每个线程数下 recall/QPS 的 Pareto 前沿（没有其他配置在两项上都不差且至少一项更好）
+#include "../hnsw_service/hnsw_graph.h"
+#include "../hnsw_service/live_index.h"
+#include "../index_builder/vector_reader.h"
+#include <../nlohmann/json.hpp>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+// 丢弃写入的内容；optimized 模式的加载和搜索往 std::cout 打印大量调试信息，基准只要结果
+// （不用 rdbuf(nullptr)：那会让多个搜索线程同时改写 cout 的错误状态）
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+static size_t current_rss_kb()
+{
+    std::ifstream statm("/proc/self/statm");
+    long total_pages = 0, rss_pages = 0;
+    statm >> total_pages >> rss_pages;
+    return rss_pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static size_t peak_rss_kb()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (size_t)ru.ru_maxrss;
+}
+
+static std::vector<size_t> parse_list(const std::string& s)
+{
+    std::vector<size_t> out;
+    size_t start = 0;
+    while (start < s.size()) {
+        size_t end = s.find(',', start);
+        if (end == std::string::npos) end = s.size();
+        if (end > start) out.push_back(std::stoul(s.substr(start, end - start)));
+        start = end + 1;
+    }
+    return out;
+}
+
+// .ivecs：每行 int32 n + n 个 int32
+static std::vector<std::vector<uint32_t>> read_ivecs(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("cannot open " + path);
+    std::vector<std::vector<uint32_t>> rows;
+    int32_t n;
+    while (in.read(reinterpret_cast<char*>(&n), sizeof(n))) {
+        if (n < 0) throw std::runtime_error(path + ": bad row length " + std::to_string(n));
+        std::vector<uint32_t> row(n);
+        if (!in.read(reinterpret_cast<char*>(row.data()), n * sizeof(uint32_t)))
+            throw std::runtime_error(path + ": truncated row " + std::to_string(rows.size()));
+        rows.push_back(std::move(row));
+    }
+    return rows;
+}
+
+// 单个查询的计数，各线程分别累加，结束后求和
+struct Counters {
+    uint64_t distance_computations = 0;
+    uint64_t hops = 0;
+    uint64_t remote_fetches = 0;
+    uint64_t cache_hits = 0;
+    uint64_t cache_misses = 0;
+
+    void add(const Counters& o) {
+        distance_computations += o.distance_computations;
+        hops += o.hops;
+        remote_fetches += o.remote_fetches;
+        cache_hits += o.cache_hits;
+        cache_misses += o.cache_misses;
+    }
+};
+
+// 搜索第 q 个查询，结果 id 写入 out
+using SearchFn = std::function<void(size_t q, std::vector<uint32_t>& out, Counters& c)>;
+
+struct RunResult {
+    double wall_s = 0;
+    std::vector<uint64_t> latency_ns;
+    std::vector<std::vector<uint32_t>> ids;
+    Counters counters;
+};
+
+static RunResult run_queries(const SearchFn& search, size_t nq, size_t threads)
+{
+    RunResult r;
+    r.latency_ns.resize(nq);
+    r.ids.resize(nq);
+    std::vector<Counters> per_thread(threads);
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto worker = [&](size_t t) {
+        try {
+            while (true) {
+                size_t q = next.fetch_add(1);
+                if (q >= nq) break;
+                auto t0 = Clock::now();
+                search(q, r.ids[q], per_thread[t]);
+                r.latency_ns[q] = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            error = std::current_exception();
+            next = nq;
+        }
+    };
+
+    auto start = Clock::now();
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; t++) pool.emplace_back(worker, t);
+    worker(0);
+    for (auto& th : pool) th.join();
+    r.wall_s = std::chrono::duration<double>(Clock::now() - start).count();
+    if (error) std::rethrow_exception(error);
+    for (const auto& c : per_thread) r.counters.add(c);
+    return r;
+}
+
+static double recall_at_k(const std::vector<std::vector<uint32_t>>& ids, const std::vector<std::vector<uint32_t>>& gt, size_t k)
+{
+    double total = 0;
+    for (size_t q = 0; q < ids.size(); q++) {
+        size_t kk = std::min(k, gt[q].size());
+        if (kk == 0) continue;
+        std::unordered_set<uint32_t> truth(gt[q].begin(), gt[q].begin() + kk);
+        size_t hit = 0;
+        for (size_t i = 0; i < ids[q].size() && i < k; i++) hit += truth.count(ids[q][i]);
+        total += (double)hit / kk;
+    }
+    return ids.empty() ? 0 : total / ids.size();
+}
+
+// 已排序的耗时取分位数，单位微秒
+static double percentile_us(const std::vector<uint64_t>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    size_t i = std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5));
+    return sorted[i] / 1000.0;
+}
+
+static void mark_pareto(json& rows)
+{
+    for (auto& a : rows) {
+        bool dominated = false;
+        for (const auto& b : rows) {
+            if (&a == &b || b["threads"] != a["threads"]) continue;
+            double ra = a["recall"], qa = a["qps"], rb = b["recall"], qb = b["qps"];
+            if (rb >= ra && qb >= qa && (rb > ra || qb > qa)) {
+                dominated = true;
+                break;
+            }
+        }
+        a["pareto"] = !dominated;
+    }
+}
+
+static const char* CSV_COLUMNS[] = {"algorithm", "parameters", "threads", "k", "recall", "qps", "mean_us", "p50_us",
+                                    "p90_us", "p95_us", "p99_us", "p999_us", "dist_comps", "hops", "remote_fetches",
+                                    "cache_hit_rate", "rss_kb", "pareto"};
+
+static void write_csv(const std::string& path, const json& rows)
+{
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("cannot open " + path);
+    for (size_t i = 0; i < std::size(CSV_COLUMNS); i++) out << (i ? "," : "") << CSV_COLUMNS[i];
+    out << "\n";
+    for (const auto& r : rows) {
+        for (size_t i = 0; i < std::size(CSV_COLUMNS); i++) {
+            const json& v = r.contains(CSV_COLUMNS[i]) ? r[CSV_COLUMNS[i]] : json();
+            out << (i ? "," : "");
+            if (v.is_string()) {
+                // 字符串按 RFC 4180 加引号，内部的引号写两次（parameters 是 JSON 文本）
+                out << '"';
+                for (char ch : v.get<std::string>()) out << (ch == '"' ? "\"\"" : std::string(1, ch));
+                out << '"';
+            }
+            else if (!v.is_null()) out << v.dump();
+        }
+        out << "\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string index_path, queries_path, query_format, gt_path, out_path, quant;
+    std::string mode = "hnsw", storage = "http://127.0.0.1:8081";
+    size_t dim = 0, k = 10, runs = 1, warmup = 0, max_queries = 0;
+    bool use_mmap = false;
+    std::vector<size_t> efs = {10, 20, 40, 80, 120, 200, 400, 800};
+    std::vector<size_t> caches = {0};
+    std::vector<size_t> thread_counts;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--index" && i + 1 < argc) index_path = argv[++i];
+        else if (a == "--queries" && i + 1 < argc) queries_path = argv[++i];
+        else if (a == "--query-format" && i + 1 < argc) query_format = argv[++i];
+        else if (a == "--gt" && i + 1 < argc) gt_path = argv[++i];
+        else if (a == "--out" && i + 1 < argc) out_path = argv[++i];
+        else if (a == "--mode" && i + 1 < argc) mode = argv[++i];
+        else if (a == "--storage" && i + 1 < argc) storage = argv[++i];
+        else if (a == "--quant" && i + 1 < argc) quant = argv[++i];
+        else if (a == "--mmap" && i + 1 < argc) {
+            std::string val = argv[++i];
+            use_mmap = (val == "1" || val == "true" || val == "True");
+        }
+        else if (a == "--dim" && i + 1 < argc) dim = std::stoul(argv[++i]);
+        else if (a == "--k" && i + 1 < argc) k = std::stoul(argv[++i]);
+        else if (a == "--ef" && i + 1 < argc) efs = parse_list(argv[++i]);
+        else if (a == "--cache" && i + 1 < argc) caches = parse_list(argv[++i]);
+        else if (a == "--threads" && i + 1 < argc) thread_counts = parse_list(argv[++i]);
+        else if (a == "--runs" && i + 1 < argc) runs = std::max<size_t>(std::stoul(argv[++i]), 1);
+        else if (a == "--warmup" && i + 1 < argc) warmup = std::stoul(argv[++i]);
+        else if (a == "--max-queries" && i + 1 < argc) max_queries = std::stoul(argv[++i]);
+        else {
+            std::cerr << "unknown argument " << a << "\n";
+            return 1;
+        }
+    }
+    if (index_path.empty() || queries_path.empty() || gt_path.empty() || k == 0 || efs.empty() || caches.empty()) {
+        std::cerr << "usage: hnsw_bench --index <file> --queries <file> --gt <file.ivecs> [--mode hnsw|optimized] "
+                     "[--k 10] [--ef 10,20,...] [--cache 0,...] [--threads 1,2,...] [--runs 1] [--warmup 0] "
+                     "[--quant q] [--mmap 1] [--storage url] [--max-queries n] [--out results.json|.csv]\n";
+        return 1;
+    }
+    if (mode != "hnsw" && mode != "optimized") {
+        std::cerr << "unknown --mode " << mode << ", expected hnsw or optimized\n";
+        return 1;
+    }
+    if (thread_counts.empty()) {
+        size_t hw = std::max<unsigned>(std::thread::hardware_concurrency(), 1);
+        for (size_t t = 1; t < hw; t *= 2) thread_counts.push_back(t);
+        thread_counts.push_back(hw);
+    }
+
+    NullBuffer null_buffer;
+    std::streambuf* cout_buf = std::cout.rdbuf();
+    try {
+        VectorReader qreader(queries_path, query_format, dim);
+        size_t nq = qreader.count();
+        if (max_queries) nq = std::min(nq, max_queries);
+        dim = qreader.dim();
+        std::vector<std::vector<float>> queries(nq, std::vector<float>(dim));
+        for (auto& q : queries) qreader.read(q.data(), 1);
+        auto gt = read_ivecs(gt_path);
+        if (gt.size() < nq) throw std::runtime_error(gt_path + " has " + std::to_string(gt.size()) + " rows for " +
+                                                     std::to_string(nq) + " queries");
+        if (!gt.empty() && gt[0].size() < k)
+            std::cerr << "warning: ground truth has only " << gt[0].size() << " neighbours per query, k=" << k << "\n";
+
+        size_t rss_before = current_rss_kb();
+        auto t_load = Clock::now();
+        std::shared_ptr<LiveIndex> live;
+        std::shared_ptr<HNSWGraph> graph;
+        if (mode == "hnsw") {
+            live = std::make_shared<LiveIndex>((int)dim, index_path, use_mmap, false, quant);
+        } else {
+            std::cout.rdbuf(&null_buffer);
+            graph = std::make_shared<HNSWGraph>();
+            bool ok = graph->load_from_file(index_path + ".adj", true);
+            if (!ok) throw std::runtime_error("cannot load " + index_path + ".adj");
+            graph->initialize_http_client(storage);
+        }
+        double load_s = std::chrono::duration<double>(Clock::now() - t_load).count();
+        size_t rss_after = current_rss_kb();
+        size_t index_rss_kb = rss_after > rss_before ? rss_after - rss_before : 0;
+        std::cerr << "loaded " << index_path << " (" << mode << ") in " << load_s << "s, index rss "
+                  << index_rss_kb << " KB, " << nq << " queries\n";
+
+        json rows = json::array();
+        std::printf("%-10s %-26s %7s %8s %10s %9s %9s %9s %11s\n", "mode", "parameters", "threads", "recall", "qps",
+                    "p50_us", "p99_us", "p999_us", "dist_comps");
+
+        for (size_t cache : (mode == "optimized" ? caches : std::vector<size_t>{0})) {
+            for (size_t ef : efs) {
+                SearchFn search;
+                json params;
+                params["ef"] = ef;
+                if (mode == "hnsw") {
+                    search = [&, ef](size_t q, std::vector<uint32_t>& out, Counters& c) {
+                        hnswlib::SearchStats stats;
+                        hnswlib::SearchParams sp;
+                        sp.ef = ef;
+                        sp.stats = &stats;
+                        auto res = live->search(queries[q].data(), k, sp);
+                        out.resize(res.size());
+                        for (size_t i = res.size(); i-- > 0; res.pop()) out[i] = (uint32_t)res.top().second;
+                        c.distance_computations += stats.distance_computations;
+                        c.hops += stats.hops;
+                    };
+                } else {
+                    params["cache"] = cache;
+                    search = [&, ef](size_t q, std::vector<uint32_t>& out, Counters& c) {
+                        QueryStats stats;
+                        auto res = graph->search_candidates(*graph, storage, queries[q], graph->entrypoint, ef, k, &stats);
+                        out.resize(res.size());
+                        for (size_t i = 0; i < res.size(); i++) out[i] = res[i].first;
+                        c.distance_computations += stats.distance_computations;
+                        c.hops += stats.hops;
+                        c.remote_fetches += stats.remote_fetches;
+                        c.cache_hits += stats.cache_hits;
+                        c.cache_misses += stats.cache_misses;
+                    };
+                }
+
+                for (size_t threads : thread_counts) {
+                    if (graph) {
+                        // 每个配置从空缓存开始，结果不受前一个配置的影响
+                        graph->vector_cache.set_capacity(0);
+                        graph->vector_cache.set_capacity(cache);
+                    }
+                    if (warmup) run_queries(search, std::min(warmup, nq), threads);
+
+                    RunResult best;
+                    for (size_t r = 0; r < runs; r++) {
+                        RunResult cur = run_queries(search, nq, threads);
+                        if (r == 0 || cur.wall_s < best.wall_s) best = std::move(cur);
+                    }
+                    std::vector<uint64_t> lat = best.latency_ns;
+                    std::sort(lat.begin(), lat.end());
+                    double mean_ns = 0;
+                    for (uint64_t v : lat) mean_ns += v;
+                    mean_ns /= std::max<size_t>(lat.size(), 1);
+
+                    json row;
+                    row["algorithm"] = mode == "hnsw" ? (quant.empty() ? "hnsw" : "hnsw-" + quant) : "hnsw-optimized";
+                    row["parameters"] = params.dump();
+                    row["threads"] = threads;
+                    row["k"] = k;
+                    row["recall"] = recall_at_k(best.ids, gt, k);
+                    row["qps"] = nq / std::max(best.wall_s, 1e-9);
+                    row["mean_us"] = mean_ns / 1000.0;
+                    row["p50_us"] = percentile_us(lat, 0.50);
+                    row["p90_us"] = percentile_us(lat, 0.90);
+                    row["p95_us"] = percentile_us(lat, 0.95);
+                    row["p99_us"] = percentile_us(lat, 0.99);
+                    row["p999_us"] = percentile_us(lat, 0.999);
+                    row["dist_comps"] = (double)best.counters.distance_computations / std::max<size_t>(nq, 1);
+                    row["hops"] = (double)best.counters.hops / std::max<size_t>(nq, 1);
+                    if (graph) {
+                        uint64_t lookups = best.counters.cache_hits + best.counters.cache_misses;
+                        row["remote_fetches"] = (double)best.counters.remote_fetches / std::max<size_t>(nq, 1);
+                        row["cache_hit_rate"] = lookups ? (double)best.counters.cache_hits / lookups : 0.0;
+                    }
+                    row["rss_kb"] = current_rss_kb();
+                    std::printf("%-10s %-26s %7zu %8.4f %10.1f %9.1f %9.1f %9.1f %11.1f\n", mode.c_str(),
+                                row["parameters"].get<std::string>().c_str(), threads, row["recall"].get<double>(),
+                                row["qps"].get<double>(), row["p50_us"].get<double>(), row["p99_us"].get<double>(),
+                                row["p999_us"].get<double>(), row["dist_comps"].get<double>());
+                    std::fflush(stdout);
+                    rows.push_back(row);
+                }
+            }
+        }
+        std::cout.rdbuf(cout_buf);
+        mark_pareto(rows);
+
+        if (!out_path.empty()) {
+            bool csv = out_path.size() >= 4 && out_path.compare(out_path.size() - 4, 4, ".csv") == 0;
+            if (csv) {
+                write_csv(out_path, rows);
+            } else {
+                json doc;
+                doc["index"] = index_path;
+                doc["mode"] = mode;
+                doc["queries"] = nq;
+                doc["dim"] = dim;
+                doc["k"] = k;
+                doc["load_s"] = load_s;
+                doc["memory"] = {{"index_rss_kb", index_rss_kb}, {"rss_kb", current_rss_kb()}, {"peak_rss_kb", peak_rss_kb()}};
+                doc["results"] = rows;
+                std::ofstream out(out_path);
+                if (!out) throw std::runtime_error("cannot open " + out_path);
+                out << doc.dump(2) << "\n";
+            }
+            std::cerr << "wrote " << rows.size() << " results to " << out_path << "\n";
+        }
+    } catch (const std::exception& e) {
+        std::cout.rdbuf(cout_buf);
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}